@@ -37,6 +37,11 @@ void eventDispatch(A9G_Event_t *event) {
       Serial.println(event->param1);
       break;
 
+    case EVENT_CREG:
+      Serial.print("Registration: ");
+      Serial.println(event->param1);
+      break;
+
     case EVENT_IMEI:
       Serial.print("IMEI: ");
       Serial.println(event->param2);
@@ -100,11 +105,21 @@ void setup() {
   delay(3000);
   Serial.println("***********Read CCID ***********");
   gsm.ReadCCID();
+
+  // From here on AT+CSQ is sent every 30s whenever the module is idle, with the cell in each sample.
+  gsm.BeginSignalMonitor(30000);
 }
 
 void loop() {
   gsm.executeCallback();
 
+  static unsigned long last_print = 0;
+  Signal_Sample_t signal;
+  if (millis() - last_print > 60000 && gsm.GetSignal(&signal)) {
+    last_print = millis();
+    Serial.printf("rssi %u ber %u creg %d lac %04X ci %04lX\n", signal.rssi, signal.ber, signal.creg, signal.lac, (unsigned long)signal.ci);
+  }
+
   delay(15);
 }
 
@@ -0,0 +1,81 @@
+/*********************************************************************************
+   Two A9G modules on two UARTs, e.g. with SIM cards from different carriers.
+   Readings go out on the healthier link and fail over to the other one,
+   a larger upload is split over both.
+*********************************************************************************/
+
+
+#include <Arduino.h>
+#include <A9G.h>
+#include <A9G_Multi.h>
+
+#define BROKER_NAME     "broker.hivemq.com"
+#define PORT            1883
+#define PUB_TOPIC       "IoT/PUB"
+#define UPLOAD_TOPIC    "IoT/UPLOAD"
+#define KEEP_ALIVE      120
+
+HardwareSerial A9G_A(1);
+HardwareSerial A9G_B(2);
+GSM gsmA(1);
+GSM gsmB(1);
+A9G_Multi links;
+
+unsigned long tic = millis();
+unsigned long upload_tic = millis();
+uint8_t upload[2048];
+
+bool bringUp(GSM &gsm, const char *client_id) {
+  if (!gsm.waitForReady()) {
+    return false;
+  }
+  gsm.AttachToGPRS();
+  gsm.SetAPN("IP", "internet");
+  gsm.ActivatePDP();
+  gsm.DisconnectBroker();
+  if (!gsm.ConnectToBroker(BROKER_NAME, PORT, client_id, KEEP_ALIVE, 0)) {
+    return false;
+  }
+  // RSSI for the health score.
+  gsm.BeginSignalMonitor(10000);
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  A9G_A.begin(115200, SERIAL_8N1, 25, 26);
+  A9G_B.begin(115200, SERIAL_8N1, 16, 17);
+  gsmA.init(&A9G_A);
+  gsmB.init(&A9G_B);
+
+  Serial.printf("Link A: %s\n", bringUp(gsmA, "dual-a") ? "up" : "down");
+  Serial.printf("Link B: %s\n", bringUp(gsmB, "dual-b") ? "up" : "down");
+  links.add(&gsmA);
+  links.add(&gsmB);
+}
+
+void loop() {
+  links.poll();
+
+  if (millis() - tic >= 5000) {
+    AT_Result_t result = links.publish(PUB_TOPIC, "Hello IoT");
+    Serial.printf("publish %s on link %d, %lu ms\n", result ? "ok" : "failed", links.active(), (unsigned long)result.latency_ms);
+    tic = millis();
+  }
+
+  if (millis() - upload_tic >= 60000) {
+    // 8 chunks of 256 bytes to IoT/UPLOAD/<n>/8, both links busy at once.
+    Serial.println(links.stripe(UPLOAD_TOPIC, upload, sizeof(upload), 256) ? "upload done" : "upload failed");
+    for (uint8_t i = 0; i < MULTI_MAX_LINKS; i++) {
+      Link_Health_t health;
+      if (links.getHealth(i, &health)) {
+        Serial.printf("link %u: score %d, rssi %u, %lu ms, %lu sent\n", i, health.score, health.rssi,
+                      (unsigned long)health.latency_ms, (unsigned long)health.published);
+      }
+    }
+    upload_tic = millis();
+  }
+
+  delay(15);
+}
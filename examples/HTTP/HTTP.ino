@@ -0,0 +1,62 @@
+/*********************************************************************************
+   HTTP example.
+
+   The response body is printed as it arrives, so it can be far larger than the
+   ESP32's RAM. Any Print works as the target: Serial, a File, or your own class
+   that hashes or flashes the data. The POST body is read from a Stream in the
+   same way.
+*********************************************************************************/
+
+#include <Arduino.h>
+#include <A9G.h>
+#include <StreamString.h>
+
+HardwareSerial A9G(2);
+GSM gsm(1);
+
+const int gsm_pin = 15;
+
+
+void setup() {
+  Serial.begin(115200);
+
+  pinMode(gsm_pin, OUTPUT);
+  digitalWrite(gsm_pin, HIGH);
+  delay(4000);
+  digitalWrite(gsm_pin, LOW);
+  delay(2000);
+  Serial.println("A9G Test Begin !");
+
+  A9G.begin(115200);
+  gsm.init(&A9G);
+
+  if (gsm.waitForReady()) {
+    Serial.println("A9G Ready");
+  }
+
+  if (gsm.WarmStart("IP", "internet")) {
+    Serial.println("GPRS bearer up");
+  }
+
+  HTTP_Response_t response;
+  if (gsm.HTTPGet("http://httpbin.org/get", &Serial, &response)) {
+    Serial.printf("\nstatus %d, %u bytes, complete %d\n", response.status, (unsigned)response.body_len, response.complete);
+  } else {
+    Serial.println("GET failed");
+  }
+
+  StreamString form;
+  form.print("device=a9g&uptime=");
+  form.print(millis());
+  if (gsm.HTTPPost("http://httpbin.org/post", "application/x-www-form-urlencoded", &form, &Serial, &response)) {
+    Serial.printf("\nstatus %d\n", response.status);
+  } else {
+    Serial.println("POST failed");
+  }
+}
+
+void loop() {
+  gsm.executeCallback();
+
+  delay(15);
+}
@@ -0,0 +1,95 @@
+/*********************************************************************************
+   Low power example for ESP32.
+
+   The A9G sleeps whenever its UART is quiet and the ESP32 light-sleeps until the
+   module reports something (new SMS, MQTT message) or the report timer expires.
+   Light sleep keeps RAM, so the parser carries on where it left off. With deep
+   sleep the ESP32 restarts, and URCs that arrive while it boots are lost.
+*********************************************************************************/
+
+#include <Arduino.h>
+#include <A9G.h>
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+
+HardwareSerial A9G(2);
+GSM gsm(1);
+
+const int gsm_pin = 15;
+const gpio_num_t gsm_rx_pin = GPIO_NUM_16;                // ESP32 RX2, connected to A9G TX
+const uint64_t report_interval_us = 15ULL * 60 * 1000000; // wake every 15 minutes
+
+
+void eventDispatch(A9G_Event_t *event) {
+  switch (event->id) {
+    case EVENT_MQTTPUBLISH:
+      Serial.print("Topic: ");
+      Serial.println(event->topic);
+      Serial.printf("message: %s\n", event->message);
+      break;
+
+    case EVENT_NEW_SMS_RECEIVED:
+      Serial.print("Number: ");
+      Serial.println(event->number);
+      Serial.print("Message: ");
+      Serial.println(event->message);
+      break;
+
+    case EVENT_CSQ:
+      Serial.print("CSQ: ");
+      Serial.println(event->param1);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  pinMode(gsm_pin, OUTPUT);
+  digitalWrite(gsm_pin, HIGH);
+  delay(4000);
+  digitalWrite(gsm_pin, LOW);
+  delay(2000);
+  Serial.println("A9G Low Power Test Begin !");
+
+  A9G.begin(115200);
+  gsm.init(&A9G);
+  gsm.EventDispatch(eventDispatch);
+
+  if (gsm.waitForReady()) {
+    Serial.println("A9G Ready");
+  }
+
+  gsm.ActivateTE();
+  gsm.SetFormatReading(true);
+
+  if (gsm.SetSleepMode(true)) {
+    Serial.println("A9G sleep mode on");
+  }
+
+  // The start bit of the first byte from the module wakes the ESP32.
+  gpio_wakeup_enable(gsm_rx_pin, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(report_interval_us);
+}
+
+void loop() {
+  gsm.executeCallback();
+
+  // Finish whatever is buffered or in flight before sleeping.
+  if (!gsm.bIsIdle()) {
+    return;
+  }
+
+  Serial.flush();
+  esp_light_sleep_start();
+  gsm.ResumeAfterSleep();
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+    // No need to wake the module first, the library does it before writing.
+    gsm.ReadCSQ();
+  }
+}
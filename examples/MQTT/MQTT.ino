@@ -62,6 +62,11 @@ void eventDispatch(A9G_Event_t *event) {
       Serial.println(event->param2);
       break;
 
+    case EVENT_READY:
+      Serial.print("Ready state: ");
+      Serial.println(event->param1);
+      break;
+
     case EVENT_CME:
       Serial.print("CME ERROR Message:");
       gsm.errorPrintCME(event->error);
@@ -77,24 +82,30 @@ void eventDispatch(A9G_Event_t *event) {
   }
 }
 
+void gsmPowerCycle() {
+  digitalWrite(gsm_pin, HIGH);
+  delay(4000);
+  digitalWrite(gsm_pin, LOW);
+  delay(2000);
+}
+
 void setup() {
   Serial.begin(115200);
 
   // GSM power reset would be best for specially in bangladesh 2g/3g network. it's not mandatory but try to use it.
   pinMode(gsm_pin, OUTPUT);
-  digitalWrite(gsm_pin, HIGH);
-  delay(4000);
-  digitalWrite(gsm_pin, LOW);
-  delay(2000);
+  gsmPowerCycle();
   Serial.println("A9G Test Begin !");
 
   A9G.begin(115200);
   gsm.init(&A9G);
   gsm.EventDispatch(eventDispatch);
+  // Messages on the subscribed topic are delivered ahead of GPS and other pending events.
+  gsm.SetControlTopic(SUB_TOPIC);
+  // Called again if the module does not report READY in time.
+  gsm.SetPowerCycle(gsmPowerCycle);
 
-
- 
-  //Don not use this function if you are not aware of this funciton. it's fully blocking code but it's very usefull.
+  // Blocks until READY, NO SIM CARD or the timeout. Use BeginReadyWait() and EVENT_READY to wait without blocking.
   if(gsm.waitForReady()){
     Serial.println("A9G Ready");
   }
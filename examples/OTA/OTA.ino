@@ -0,0 +1,93 @@
+/*********************************************************************************
+   OTA example for ESP32.
+
+   Downloads a firmware image over the A9G in 4 KB ranges into the next OTA
+   partition and checks its SHA-256. The progress is kept in RTC memory, so a
+   dropped link or a watchdog reset continues at the last good offset instead of
+   starting over.
+
+   The server must answer "fw.bin?range=<first>-<last>" with exactly those bytes.
+   Size and digest usually come from a small manifest fetched first.
+
+   The module is driven through the ESP-IDF UART driver (A9G_UartTransport)
+   rather than HardwareSerial, so the 4 KB ranges land in the driver's ring
+   buffer even while flash is being erased and written.
+*********************************************************************************/
+
+#include <Arduino.h>
+#include <A9G.h>
+#include <A9G_OTA.h>
+
+#define FIRMWARE_URL    "http://example.com/fw.bin"
+#define FIRMWARE_SIZE   1048576
+
+// sha256sum fw.bin
+static const uint8_t FIRMWARE_SHA256[32] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+A9G_UartTransport a9g_uart;
+GSM gsm(1);
+A9G_OTA ota;
+
+RTC_NOINIT_ATTR OTA_State_t ota_state;
+
+const int gsm_pin = 15;
+
+
+void setup() {
+  Serial.begin(115200);
+
+  pinMode(gsm_pin, OUTPUT);
+  digitalWrite(gsm_pin, HIGH);
+  delay(4000);
+  digitalWrite(gsm_pin, LOW);
+  delay(2000);
+
+  // UART2 on its default pins: RX 16, TX 17.
+  if (!a9g_uart.begin(UART_NUM_2, 115200, 16, 17)) {
+    Serial.println("UART driver install failed");
+    return;
+  }
+  gsm.init(&a9g_uart);
+
+  if (gsm.waitForReady()) {
+    Serial.println("A9G Ready");
+  }
+  gsm.WarmStart("IP", "internet");
+
+  if (!ota.begin(&gsm, FIRMWARE_URL, FIRMWARE_SIZE, FIRMWARE_SHA256, &ota_state)) {
+    Serial.println("No OTA partition or image too large");
+    return;
+  }
+  Serial.printf("Starting at %u of %u\n", (unsigned)ota.offset(), (unsigned)ota.size());
+}
+
+void loop() {
+  switch (ota.poll()) {
+    case OTA_IN_PROGRESS:
+      Serial.printf("%u / %u\n", (unsigned)ota.offset(), (unsigned)ota.size());
+      break;
+
+    case OTA_RETRY:
+      // The link dropped; bring the bearer back and continue where we stopped.
+      delay(5000);
+      gsm.WarmStart("IP", "internet");
+      break;
+
+    case OTA_DONE:
+      Serial.println("Update verified, restarting");
+      delay(1000);
+      ESP.restart();
+      break;
+
+    case OTA_BAD_HASH:
+      Serial.println("Digest mismatch, image discarded");
+      while (1) delay(1000);
+
+    default:
+      Serial.println("Update failed");
+      while (1) delay(1000);
+  }
+}
@@ -0,0 +1,96 @@
+/*********************************************************************************
+   Warm start example for ESP32.
+
+   The module state cache lives in RTC memory that survives watchdog and software
+   resets. After such a reset the A9G is still running, so the power cycle and
+   waitForReady() are skipped and WarmStart() only sends the commands whose state
+   differs, usually a single AT+CGACT? query.
+*********************************************************************************/
+
+#include <Arduino.h>
+#include <A9G.h>
+#include "esp_system.h"
+
+#define BROKER_NAME     "broker.hivemq.com"
+#define PORT            1883
+#define UNIQUE_ID       "dknvkfdnvj"
+#define PUB_TOPIC       "IoT/PUB"
+#define SUB_TOPIC       "IoT/SUB"
+#define CLEAN_SEASSION  0
+#define KEEP_ALIVE      120
+
+HardwareSerial A9G(2);
+GSM gsm(1);
+
+RTC_NOINIT_ATTR A9G_State_t gsm_state;
+
+const int gsm_pin = 15;
+unsigned long tic = millis();
+
+
+void eventDispatch(A9G_Event_t *event) {
+  switch (event->id) {
+    case EVENT_MQTTPUBLISH:
+      Serial.print("Topic: ");
+      Serial.println(event->topic);
+      Serial.printf("message: %s\n", event->message);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  A9G.begin(115200);
+  gsm.init(&A9G);
+  gsm.EventDispatch(eventDispatch);
+  gsm.SetStateStore(&gsm_state);
+
+  bool cold = esp_reset_reason() == ESP_RST_POWERON || !gsm.bIsReady();
+  if (cold) {
+    Serial.println("Cold start");
+    pinMode(gsm_pin, OUTPUT);
+    digitalWrite(gsm_pin, HIGH);
+    delay(4000);
+    digitalWrite(gsm_pin, LOW);
+    delay(2000);
+
+    // The module restarted, whatever was cached is stale.
+    memset(&gsm_state, 0, sizeof(gsm_state));
+    gsm.SetStateStore(&gsm_state);
+
+    if (gsm.waitForReady()) {
+      Serial.println("A9G Ready");
+    }
+  }
+
+  if (gsm.WarmStart("IP", "internet")) {
+    Serial.println("GPRS bearer up");
+  } else {
+    Serial.println("GPRS bearer fail");
+  }
+
+  // The broker connection cannot be queried; if the module still holds one, reconnect it.
+  if (!gsm.ConnectToBroker(BROKER_NAME, PORT, UNIQUE_ID, KEEP_ALIVE, CLEAN_SEASSION)) {
+    gsm.DisconnectBroker();
+    if (gsm.ConnectToBroker(BROKER_NAME, PORT, UNIQUE_ID, KEEP_ALIVE, CLEAN_SEASSION)) {
+      Serial.println("Broker Connect Success");
+    }
+  }
+
+  gsm.SubscribeToTopic(SUB_TOPIC, 1, 0);
+}
+
+void loop() {
+  gsm.executeCallback();
+
+  if (millis() - tic >= 5000) {
+    gsm.PublishToTopic(PUB_TOPIC, "Hello IoT");
+    tic = millis();
+  }
+
+  delay(15);
+}
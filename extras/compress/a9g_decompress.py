@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Decode payloads sent with GSM::SetCompression() (see src/A9G_Compress.h).
+
+  a9g_decompress.py PAYLOAD ...    print each payload decoded; PAYLOAD is the MQTT message or SMS text
+  a9g_decompress.py -              read one payload per line from stdin
+
+Payloads that are not compressed frames are printed unchanged, so the same code path can handle
+devices with and without compression. Import decode() to use it in a backend.
+"""
+
+import argparse
+import base64
+import binascii
+import sys
+
+MAGIC = 0xC5
+FLAG_LZSS = 0x01
+MIN_MATCH = 3
+
+
+def decompress(frame):
+    """Returns the uncompressed bytes of a frame, raises ValueError if it is not a valid frame."""
+    if len(frame) < 3 or frame[0] != MAGIC or frame[1] != FLAG_LZSS:
+        raise ValueError("not a compressed frame")
+    pos = 2
+    total = 0
+    shift = 0
+    while True:
+        if pos >= len(frame):
+            raise ValueError("truncated length")
+        b = frame[pos]
+        pos += 1
+        total |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            break
+
+    out = bytearray()
+    control = 0
+    bit = 8
+    while len(out) < total:
+        if bit == 8:
+            control = frame[pos]
+            pos += 1
+            bit = 0
+        if control & (1 << bit):
+            out.append(frame[pos])
+            pos += 1
+        else:
+            dist = (frame[pos] | (frame[pos + 1] >> 4) << 8) + 1
+            n = (frame[pos + 1] & 0x0F) + MIN_MATCH
+            pos += 2
+            if dist > len(out):
+                raise ValueError("distance out of range")
+            for _ in range(n):
+                out.append(out[-dist])
+        bit += 1
+    if len(out) != total:
+        raise ValueError("length mismatch")
+    return bytes(out)
+
+
+def decode(payload):
+    """Returns the original payload bytes for a received MQTT message or SMS text."""
+    if isinstance(payload, str):
+        payload = payload.encode()
+    try:
+        frame = base64.b64decode(payload, validate=True)
+        return decompress(frame)
+    except (binascii.Error, ValueError, IndexError):
+        return payload
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("payload", nargs="+")
+    args = parser.parse_args()
+
+    payloads = sys.stdin.read().splitlines() if args.payload == ["-"] else args.payload
+    for payload in payloads:
+        sys.stdout.buffer.write(decode(payload.strip()) + b"\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+/*!
+ * @file Arduino.h
+ *
+ * Just enough of the Arduino core to build the platform independent parts of the library on the
+ * host, see extras/test/Makefile. millis() is defined by each test.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+unsigned long millis();
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (n < size && write(buffer[n]))
+        {
+            n++;
+        }
+        return n;
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = 0;
+        int c;
+        while (n < length && (c = read()) >= 0)
+        {
+            buffer[n++] = (char)c;
+        }
+        return n;
+    }
+};
+
+#endif
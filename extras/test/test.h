@@ -0,0 +1,36 @@
+/*!
+ * @file test.h
+ *
+ * Minimal checks for the host tests. A failed CHECK() is reported and the test carries on; main()
+ * ends with TEST_END(), whose value is the exit status.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_TEST_H
+#define A9G_TEST_H
+
+#include <Arduino.h>
+
+static int test_failures = 0;
+static unsigned long test_ms = 0; // what millis() returns
+
+unsigned long millis()
+{
+    return test_ms;
+}
+
+#define CHECK(cond)                                                              \
+    do                                                                           \
+    {                                                                            \
+        if (!(cond))                                                             \
+        {                                                                        \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);      \
+            test_failures++;                                                     \
+        }                                                                        \
+    } while (0)
+
+#define TEST_END() (printf("%s: %s\n", __FILE__, test_failures ? "FAIL" : "PASS"), test_failures ? 1 : 0)
+
+#endif
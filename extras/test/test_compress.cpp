@@ -0,0 +1,123 @@
+/*!
+ * @file test_compress.cpp
+ *
+ * LZSS frames: round trips, frame layout, bounds and damaged input.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include <string>
+#include <vector>
+#include "test.h"
+#include "A9G_Compress.h"
+
+static uint32_t random_state = 1;
+
+// Small LCG so every run sees the same data.
+static uint32_t nextRandom()
+{
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+static bool roundTrip(const std::string &in)
+{
+    std::vector<uint8_t> frame(compressBound(in.size()));
+    std::vector<uint8_t> out(in.size() + 1);
+    size_t frame_len = compressFrame((const uint8_t *)in.data(), in.size(), frame.data(), frame.size());
+    if (!frame_len)
+    {
+        return false;
+    }
+    size_t out_len = decompressFrame(frame.data(), frame_len, out.data(), out.size());
+    return out_len == in.size() && !memcmp(out.data(), in.data(), in.size());
+}
+
+static void testRoundTrip()
+{
+    CHECK(roundTrip(""));
+    CHECK(roundTrip("a"));
+    CHECK(roundTrip("abcabcabcabcabcabcabcabc"));
+    CHECK(roundTrip(std::string(10000, 'z')));
+
+    // Sizes around the window and the longest distance, alphabets from one symbol to all bytes.
+    for (int i = 0; i < 200; i++)
+    {
+        size_t len = nextRandom() % (COMPRESS_MAX_DISTANCE + 1000);
+        uint32_t alphabet = 1 + nextRandom() % 256;
+        std::string in(len, '\0');
+        for (size_t j = 0; j < len; j++)
+        {
+            in[j] = (char)(nextRandom() % alphabet);
+        }
+        CHECK(roundTrip(in));
+    }
+}
+
+static void testFrame()
+{
+    std::string json;
+    for (int i = 0; i < 20; i++)
+    {
+        char record[96];
+        snprintf(record, sizeof(record), "{\"ts\":%d,\"temp\":21.%d,\"hum\":48,\"lat\":23.81,\"lon\":90.41},", 1700000000 + i * 60, i % 10);
+        json += record;
+    }
+
+    std::vector<uint8_t> frame(compressBound(json.size()));
+    size_t frame_len = compressFrame((const uint8_t *)json.data(), json.size(), frame.data(), frame.size());
+    CHECK(frame_len > 0 && frame_len < json.size() / 2);
+
+    // magic, flags, varint length
+    CHECK(frame[0] == COMPRESS_MAGIC);
+    CHECK(frame[1] == COMPRESS_FLAG_LZSS);
+    CHECK(frame[2] == (0x80 | (json.size() & 0x7F)) && frame[3] == json.size() >> 7);
+
+    // Output too small on either side.
+    std::vector<uint8_t> small(frame_len - 1);
+    CHECK(compressFrame((const uint8_t *)json.data(), json.size(), small.data(), small.size()) == 0);
+    std::vector<uint8_t> out(json.size());
+    CHECK(decompressFrame(frame.data(), frame_len, out.data(), json.size() - 1) == 0);
+    CHECK(decompressFrame(frame.data(), frame_len, out.data(), out.size()) == json.size());
+}
+
+static void testDamaged()
+{
+    std::string in;
+    for (int i = 0; i < 2000; i++)
+    {
+        in += (char)('a' + nextRandom() % 6);
+    }
+    std::vector<uint8_t> frame(compressBound(in.size()));
+    size_t frame_len = compressFrame((const uint8_t *)in.data(), in.size(), frame.data(), frame.size());
+    std::vector<uint8_t> out(in.size());
+
+    // Wrong magic or flags, truncated frames.
+    frame[0] ^= 0xFF;
+    CHECK(decompressFrame(frame.data(), frame_len, out.data(), out.size()) == 0);
+    frame[0] ^= 0xFF;
+    frame[1] ^= 0x80;
+    CHECK(decompressFrame(frame.data(), frame_len, out.data(), out.size()) == 0);
+    frame[1] ^= 0x80;
+    for (size_t len = 0; len < frame_len; len += 1 + len / 4)
+    {
+        CHECK(decompressFrame(frame.data(), len, out.data(), out.size()) == 0);
+    }
+
+    // Flipped bytes must not read or write out of bounds; the sanitizers catch it if they do.
+    for (int i = 0; i < 500; i++)
+    {
+        std::vector<uint8_t> damaged(frame.begin(), frame.begin() + frame_len);
+        damaged[2 + nextRandom() % (frame_len - 2)] ^= 1 + nextRandom() % 255;
+        decompressFrame(damaged.data(), damaged.size(), out.data(), out.size());
+    }
+}
+
+int main()
+{
+    testRoundTrip();
+    testFrame();
+    testDamaged();
+    return TEST_END();
+}
@@ -0,0 +1,165 @@
+/*!
+ * @file test_event_lane.cpp
+ *
+ * Event lanes: FIFO order, drop policies and moving live records to the front.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include <string>
+#include "test.h"
+#include "A9G_EventLane.h"
+
+// Record data that tells which push it came from.
+static std::string payload(unsigned n, size_t len)
+{
+    std::string data(len, (char)('a' + n % 26));
+    if (len >= 4)
+    {
+        snprintf(&data[0], 4, "%03u", n % 1000);
+        data[3] = ':';
+    }
+    return data;
+}
+
+static bool frontIs(A9G_EventLane *lane, uint8_t term_id, const std::string &data)
+{
+    uint8_t id = 0xFF;
+    size_t len = 0;
+    char *front = lane->front(&id, &len);
+    return front && id == term_id && len == data.size() && !memcmp(front, data.data(), len) && front[len] == '\0';
+}
+
+static void testFifo()
+{
+    A9G_EventLane lane;
+    uint8_t id;
+    size_t len;
+
+    CHECK(lane.count() == 0 && lane.front(&id, &len) == nullptr);
+    lane.pop();
+    CHECK(lane.room() == EVENT_LANE_SIZE);
+
+    CHECK(lane.push(1, "first", 5));
+    CHECK(lane.push(2, "", 0));
+    CHECK(lane.push(3, payload(3, 300).data(), 300)); // length above one byte
+    CHECK(lane.count() == 3);
+    CHECK(lane.room() == EVENT_LANE_SIZE - EVENT_LANE_RECORD(5) - EVENT_LANE_RECORD(0) - EVENT_LANE_RECORD(300));
+
+    CHECK(frontIs(&lane, 1, "first"));
+    lane.pop();
+    CHECK(frontIs(&lane, 2, ""));
+    lane.pop();
+    CHECK(frontIs(&lane, 3, payload(3, 300)));
+
+    // The front record may be changed in place, as _processTermString() does.
+    char *front = lane.front(&id, &len);
+    front[0] = 'X';
+    CHECK(lane.front(&id, &len)[0] == 'X');
+
+    lane.pop();
+    CHECK(lane.count() == 0 && lane.room() == EVENT_LANE_SIZE);
+
+    lane.push(4, "x", 1);
+    lane.clear();
+    CHECK(lane.count() == 0 && lane.room() == EVENT_LANE_SIZE && lane.dropped == 0);
+}
+
+static void testPolicies()
+{
+    const size_t len = (EVENT_LANE_SIZE - 4 * 4) / 3 - 4; // three fit, a fourth does not
+    std::string data[5];
+    for (unsigned i = 0; i < 5; i++)
+    {
+        data[i] = payload(i, len);
+    }
+
+    // LANE_BLOCK and LANE_DROP_NEWEST refuse what does not fit and keep what is there.
+    Lane_Policy_t keep[] = {LANE_BLOCK, LANE_DROP_NEWEST};
+    for (Lane_Policy_t policy : keep)
+    {
+        A9G_EventLane lane;
+        lane.policy = policy;
+        for (unsigned i = 0; i < 3; i++)
+        {
+            CHECK(lane.push(i, data[i].data(), len));
+        }
+        CHECK(lane.room() < EVENT_LANE_RECORD(len));
+        CHECK(!lane.push(3, data[3].data(), len));
+        CHECK(lane.count() == 3 && lane.dropped == 1);
+        CHECK(frontIs(&lane, 0, data[0]));
+    }
+
+    // LANE_DROP_OLDEST drops from the front until the new record fits.
+    A9G_EventLane lane;
+    lane.policy = LANE_DROP_OLDEST;
+    for (unsigned i = 0; i < 5; i++)
+    {
+        CHECK(lane.push(i, data[i].data(), len));
+    }
+    CHECK(lane.count() == 3 && lane.dropped == 2);
+    for (unsigned i = 2; i < 5; i++)
+    {
+        CHECK(frontIs(&lane, i, data[i]));
+        lane.pop();
+    }
+
+    // A single record larger than the lane is refused whatever the policy.
+    std::string huge(EVENT_LANE_SIZE, 'h');
+    lane.push(0, "small", 5);
+    CHECK(!lane.push(1, huge.data(), EVENT_LANE_SIZE - 3));
+    CHECK(lane.count() == 1 && lane.dropped == 3);
+    CHECK(frontIs(&lane, 0, "small"));
+}
+
+static void testCompaction()
+{
+    A9G_EventLane lane;
+    unsigned pushed = 0;
+    unsigned popped = 0;
+
+    // A producer slightly ahead of the consumer with records of varying size: the live records
+    // keep reaching the end of the buffer and are moved to the front intact.
+    for (unsigned round = 0; round < 2000; round++)
+    {
+        size_t len = (round * 37) % 200;
+        if (EVENT_LANE_RECORD(len) <= lane.room())
+        {
+            CHECK(lane.push(pushed & 0xFF, payload(pushed, len).data(), len));
+            pushed++;
+        }
+        if (round % 3 != 2 || lane.room() < EVENT_LANE_SIZE / 4)
+        {
+            uint8_t id;
+            size_t front_len;
+            char *front = lane.front(&id, &front_len);
+            if (front)
+            {
+                CHECK(id == (popped & 0xFF));
+                CHECK(std::string(front, front_len) == payload(popped, front_len));
+                lane.pop();
+                popped++;
+            }
+        }
+    }
+    while (lane.count())
+    {
+        uint8_t id;
+        size_t len;
+        char *front = lane.front(&id, &len);
+        CHECK(id == (popped & 0xFF) && std::string(front, len) == payload(popped, len));
+        lane.pop();
+        popped++;
+    }
+    CHECK(pushed == popped && pushed > 1000);
+    CHECK(lane.dropped == 0 && lane.room() == EVENT_LANE_SIZE);
+}
+
+int main()
+{
+    testFifo();
+    testPolicies();
+    testCompaction();
+    return TEST_END();
+}
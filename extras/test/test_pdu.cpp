@@ -0,0 +1,210 @@
+/*!
+ * @file test_pdu.cpp
+ *
+ * PDU codec: encoding, decoding and reassembly of concatenated SMS.
+ *
+ * Outgoing SMS-SUBMIT PDUs are turned into the SMS-DELIVER the recipient would get, so every
+ * message goes through the encoder, the decoder and the reassembler.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include <string>
+#include "test.h"
+#include "A9G_PDU.h"
+
+// SMS-DELIVER for one segment encoded by pduEncodeSubmit(): same address, PID, DCS and user data.
+static bool deliver(const char submit_hex[], bool concatenated, char deliver_hex[])
+{
+    // 00 <first octet> <MR> <address length> <type> <digits...> <PID> <DCS> <UDL> <UD...>
+    size_t digits = strtoul(std::string(submit_hex + 6, 2).c_str(), NULL, 16);
+    size_t address = 4 + (digits + 1) / 2 * 2;
+    const char *rest = submit_hex + 6 + address;
+    if (strlen(submit_hex) < 6 + address + 6)
+    {
+        return false;
+    }
+    snprintf(deliver_hex, PDU_MAX_HEX_SIZE, "00%s%.*s%.4s32012141000000%s", concatenated ? "44" : "04", (int)address,
+             submit_hex + 6, rest, rest + 4);
+    return true;
+}
+
+// Sends text through encoder, decoder and reassembler, segments last first. Returns the reassembled text.
+static std::string roundTrip(PDU_Reassembler *reassembler, const char number[], const char text[], uint8_t ref)
+{
+    PDU_Encoding_t encoding;
+    uint8_t parts = pduSegmentCount(text, &encoding);
+    char submit[PDU_MAX_HEX_SIZE];
+    char hex[PDU_MAX_HEX_SIZE];
+    const char *complete = nullptr;
+    uint16_t complete_len = 0;
+
+    for (uint8_t part = parts; part >= 1; part--)
+    {
+        CHECK(pduEncodeSubmit(submit, number, text, part, ref) > 0);
+        CHECK(deliver(submit, parts > 1, hex));
+
+        PDU_Message_t message;
+        CHECK(pduDecodeDeliver(hex, &message));
+        CHECK(!strcmp(message.number, number));
+        CHECK(message.encoding == encoding);
+        CHECK(message.part_count == parts);
+        CHECK(message.part_index == part);
+
+        complete = reassembler->add(&message, &complete_len);
+        CHECK(part == 1 ? complete != nullptr : complete == nullptr);
+    }
+    return complete ? std::string(complete, complete_len) : std::string();
+}
+
+static void testEncode()
+{
+    char hex[PDU_MAX_HEX_SIZE];
+
+    // 3GPP TS 23.040 example text, international number, GSM-7.
+    CHECK(pduEncodeSubmit(hex, "+46708251358", "hellohello", 1, 0) == 22);
+    CHECK(!strcmp(hex, "0001000B916407281553F800000AE8329BFD4697D9EC37"));
+
+    // Status report requested: TP-SRR set in the first octet.
+    CHECK(pduEncodeSubmit(hex, "+46708251358", "hellohello", 1, 0, true) == 22);
+    CHECK(!strncmp(hex, "0021", 4));
+
+    // Length only.
+    CHECK(pduEncodeSubmit(nullptr, "+46708251358", "hellohello", 1, 0) == 22);
+
+    // Longest address, one digit too many and a segment that does not exist.
+    CHECK(pduEncodeSubmit(hex, "+01234567890123456789", "x", 1, 0) > 0);
+    CHECK(pduEncodeSubmit(hex, "+012345678901234567890", "x", 1, 0) == -1);
+    CHECK(pduEncodeSubmit(hex, "+46708251358", "x", 2, 0) == -1);
+}
+
+static void testSegmentCount()
+{
+    PDU_Encoding_t encoding;
+    std::string text(160, 'a');
+    CHECK(pduSegmentCount(text.c_str(), &encoding) == 1 && encoding == PDU_GSM7);
+    text += 'a';
+    CHECK(pduSegmentCount(text.c_str(), &encoding) == 2 && encoding == PDU_GSM7);
+
+    // An extension character takes two septets.
+    text.assign(159, 'a');
+    text += '{';
+    CHECK(pduSegmentCount(text.c_str(), &encoding) == 2 && encoding == PDU_GSM7);
+
+    // Cyrillic Zhe is not in the default alphabet.
+    text.clear();
+    for (int i = 0; i < 70; i++)
+    {
+        text += "\xD0\x96";
+    }
+    CHECK(pduSegmentCount(text.c_str(), &encoding) == 1 && encoding == PDU_UCS2);
+    text += "\xD0\x96";
+    CHECK(pduSegmentCount(text.c_str(), &encoding) == 2 && encoding == PDU_UCS2);
+}
+
+static void testDecode()
+{
+    PDU_Message_t message;
+
+    // 3GPP TS 23.040 example SMS-DELIVER with a service centre address.
+    CHECK(pduDecodeDeliver("07917283010010F5040BC87238880900F10000993092516195800AE8329BFD4697D9EC37", &message));
+    CHECK(!strcmp(message.number, "27838890001"));
+    CHECK(!strcmp(message.date_time, "2099/03/29,15:16:59+02"));
+    CHECK(!strcmp(message.text, "hellohello") && message.text_len == 10);
+    CHECK(message.encoding == PDU_GSM7 && message.part_count == 1 && message.part_index == 1);
+
+    // Not hex, truncated, and a status report passed as a deliver.
+    CHECK(!pduDecodeDeliver("07917283010010F5040BC872388809ZZ", &message));
+    CHECK(!pduDecodeDeliver("07917283010010F5040BC8723888", &message));
+    CHECK(!pduDecodeDeliver("00062A14911032547698103254769832012141000000320121410000000", &message));
+}
+
+static void testStatusReport()
+{
+    uint8_t mr = 0;
+    uint8_t status = 0xFF;
+    char number[PDU_MAX_NUMBER_SIZE];
+
+    // MR 42, 20 digit recipient, delivered.
+    CHECK(pduDecodeStatusReport("00062A1491103254769810325476983201214100000032012141000000" "00", &mr, number, &status));
+    CHECK(mr == 42 && status == 0);
+    CHECK(!strcmp(number, "+01234567890123456789"));
+
+    // Missing TP-ST.
+    CHECK(!pduDecodeStatusReport("00062A14911032547698103254769832012141000000320121410000", &mr, number, &status));
+}
+
+static void testRoundTrip()
+{
+    PDU_Reassembler reassembler;
+
+    // A single segment completes at once and stays readable until the next add().
+    CHECK(roundTrip(&reassembler, "+8801711111111", "hello there", 1) == "hello there");
+
+    // GSM-7 with an extension character, split in three.
+    std::string text;
+    for (int i = 0; i < 399; i++)
+    {
+        text += (char)('a' + i % 26);
+    }
+    text[10] = '{';
+    CHECK(roundTrip(&reassembler, "+8801711111111", text.c_str(), 7) == text);
+
+    // UCS-2 with three byte UTF-8 sequences.
+    const char *bengali = "\xE0\xA6\x86\xE0\xA6\xAE\xE0\xA6\xBE\xE0\xA6\xB0 \xE0\xA6\xB8\xE0\xA7\x8B\xE0\xA6\xA8\xE0\xA6\xBE\xE0\xA6\xB0 "
+                          "\xE0\xA6\xAC\xE0\xA6\xBE\xE0\xA6\x82\xE0\xA6\xB2\xE0\xA6\xBE, \xE0\xA6\x86\xE0\xA6\xAE\xE0\xA6\xBF "
+                          "\xE0\xA6\xA4\xE0\xA7\x8B\xE0\xA6\xAE\xE0\xA6\xBE\xE0\xA6\xAF\xE0\xA6\xBC \xE0\xA6\xAD\xE0\xA6\xBE"
+                          "\xE0\xA6\xB2\xE0\xA7\x8B\xE0\xA6\xAC\xE0\xA6\xBE\xE0\xA6\xB8\xE0\xA6\xBF\xE0\xA5\xA4 "
+                          "\xE0\xA6\x9A\xE0\xA6\xBF\xE0\xA6\xB0\xE0\xA6\xA6\xE0\xA6\xBF\xE0\xA6\xA8 \xE0\xA6\xA4\xE0\xA7\x8B"
+                          "\xE0\xA6\xAE\xE0\xA6\xBE\xE0\xA6\xB0 \xE0\xA6\x86\xE0\xA6\x95\xE0\xA6\xBE\xE0\xA6\xB6, "
+                          "\xE0\xA6\xA4\xE0\xA7\x8B\xE0\xA6\xAE\xE0\xA6\xBE\xE0\xA6\xB0 \xE0\xA6\xAC\xE0\xA6\xBE\xE0\xA6\xA4"
+                          "\xE0\xA6\xBE\xE0\xA6\xB8";
+    text = std::string(bengali) + " " + bengali;
+    PDU_Encoding_t encoding;
+    CHECK(pduSegmentCount(text.c_str(), &encoding) > 1 && encoding == PDU_UCS2);
+    CHECK(roundTrip(&reassembler, "+8801711111111", text.c_str(), 8) == text);
+
+    CHECK(reassembler.dropped() == 0);
+}
+
+static void testReassemblyLimits()
+{
+    PDU_Reassembler reassembler;
+    std::string text(400, 'x');
+    char submit[PDU_MAX_HEX_SIZE];
+    char hex[PDU_MAX_HEX_SIZE];
+    PDU_Message_t message;
+    uint16_t len;
+
+    // First segments of one message more than there are slots: the oldest is dropped.
+    for (uint8_t ref = 1; ref <= PDU_REASSEMBLY_SLOTS + 1; ref++)
+    {
+        test_ms += 1000;
+        CHECK(pduEncodeSubmit(submit, "+8801711111111", text.c_str(), 1, ref) > 0);
+        CHECK(deliver(submit, true, hex) && pduDecodeDeliver(hex, &message));
+        CHECK(reassembler.add(&message, &len) == nullptr);
+    }
+    CHECK(reassembler.dropped() == 1);
+
+    // A segment received twice does not complete the message.
+    CHECK(reassembler.add(&message, &len) == nullptr);
+
+    // Incomplete messages time out when the next segment comes in.
+    test_ms += PDU_REASSEMBLY_TIMEOUT_MS;
+    CHECK(pduEncodeSubmit(submit, "+8801711111111", text.c_str(), 2, 99) > 0);
+    CHECK(deliver(submit, true, hex) && pduDecodeDeliver(hex, &message));
+    CHECK(reassembler.add(&message, &len) == nullptr);
+    CHECK(reassembler.dropped() == 1 + PDU_REASSEMBLY_SLOTS);
+}
+
+int main()
+{
+    testEncode();
+    testSegmentCount();
+    testDecode();
+    testStatusReport();
+    testRoundTrip();
+    testReassemblyLimits();
+    return TEST_END();
+}
@@ -0,0 +1,184 @@
+/*!
+ * @file test_rx_buffer.cpp
+ *
+ * Receive buffer: line splitting, compaction and lines longer than RX_BUFFER_SIZE.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include <string>
+#include "test.h"
+#include "A9G_RxBuffer.h"
+
+// Hands out its data at most chunk bytes per available(), like a UART between interrupts.
+class ChunkStream : public Stream
+{
+public:
+    std::string data;
+    size_t pos = 0;
+    size_t chunk = SIZE_MAX;
+
+    int available() override
+    {
+        size_t left = data.size() - pos;
+        return left < chunk ? left : chunk;
+    }
+    int read() override
+    {
+        return pos < data.size() ? (uint8_t)data[pos++] : -1;
+    }
+    int peek() override
+    {
+        return pos < data.size() ? (uint8_t)data[pos] : -1;
+    }
+    size_t write(uint8_t) override
+    {
+        return 0;
+    }
+};
+
+// Next line as a string, "" if none is buffered.
+static std::string nextLine(A9G_RxBuffer *rx)
+{
+    size_t len = 0;
+    char *line = rx->readLine(&len);
+    if (!line)
+    {
+        return "";
+    }
+    CHECK(strlen(line) == len);
+    return std::string(line, len);
+}
+
+static void testLines()
+{
+    A9G_RxBuffer rx;
+    ChunkStream stream;
+
+    CHECK(rx.fill(&stream) == 0);
+    CHECK(nextLine(&rx) == "");
+
+    // CR/LF stripped, empty lines skipped, a bare LF ends a line too.
+    stream.data = "\r\nOK\r\n\r\n+CSQ: 20,0\r\nlast\npartial";
+    CHECK(rx.fill(&stream) == stream.data.size());
+    CHECK(nextLine(&rx) == "OK");
+    CHECK(nextLine(&rx) == "+CSQ: 20,0");
+    CHECK(nextLine(&rx) == "last");
+    CHECK(nextLine(&rx) == "");
+    CHECK(rx.pending() == 7);
+
+    // The rest of the partial line arrives later.
+    stream.data += " line\r\n";
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == "partial line");
+    CHECK(rx.pending() == 0);
+}
+
+static void testChunks()
+{
+    A9G_RxBuffer rx;
+    ChunkStream stream;
+
+    // Lines of every length that fits with its CR/LF, a few bytes per fill(), so they straddle the
+    // end of the buffer and have to be moved to the front.
+    for (size_t i = 1; i <= RX_BUFFER_SIZE - 2; i += 7)
+    {
+        stream.data += std::string(i, (char)('a' + i % 26)) + "\r\n";
+    }
+    stream.chunk = 13;
+
+    size_t i = 1;
+    while (stream.pos < stream.data.size() || rx.pending())
+    {
+        rx.fill(&stream);
+        std::string line;
+        while ((line = nextLine(&rx)) != "")
+        {
+            CHECK(line == std::string(i, (char)('a' + i % 26)));
+            i += 7;
+        }
+    }
+    CHECK(i > RX_BUFFER_SIZE - 2);
+    CHECK(rx.overflows == 0);
+
+    // The longest line kept whole.
+    stream.data = std::string(RX_BUFFER_SIZE - 2, 'w') + "\r\n";
+    stream.pos = 0;
+    stream.chunk = SIZE_MAX;
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == std::string(RX_BUFFER_SIZE - 2, 'w'));
+    CHECK(rx.overflows == 0);
+}
+
+static void testOverflow()
+{
+    A9G_RxBuffer rx;
+    ChunkStream stream;
+
+    // Cut at RX_BUFFER_SIZE, the rest up to the LF dropped, the next line intact.
+    stream.data = std::string(RX_BUFFER_SIZE + 300, 'y') + "\r\n+CSQ: 17,0\r\n";
+    std::string line;
+    std::string lines;
+    while (stream.pos < stream.data.size() || rx.pending())
+    {
+        rx.fill(&stream);
+        while ((line = nextLine(&rx)) != "")
+        {
+            lines += line + "|";
+        }
+    }
+    CHECK(lines == std::string(RX_BUFFER_SIZE, 'y') + "|+CSQ: 17,0|");
+    CHECK(rx.overflows == 1);
+
+    // Exactly full with its LF still to come.
+    stream.data = std::string(RX_BUFFER_SIZE, 'z');
+    stream.pos = 0;
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == std::string(RX_BUFFER_SIZE, 'z'));
+    stream.data = "\r\nOK\r\n";
+    stream.pos = 0;
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == "OK");
+    CHECK(rx.overflows == 2);
+}
+
+static void testPrompt()
+{
+    A9G_RxBuffer rx;
+    ChunkStream stream;
+
+    // The SMS prompt has no line end; it is looked at and consumed in place.
+    stream.data = "\r\n> ";
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == "");
+    CHECK(rx.pending() == 2);
+    CHECK(!strncmp(rx.peek(), "> ", 2));
+    rx.consume(2);
+    CHECK(rx.pending() == 0);
+
+    // Consuming more than is buffered stops at the end, clear() drops a partial line.
+    stream.data = "\r\n+CMGS: 7\r\n\r\nOK\r\nabc";
+    stream.pos = 0;
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == "+CMGS: 7");
+    rx.consume(1000);
+    CHECK(rx.pending() == 0 && nextLine(&rx) == "");
+    stream.data = "abc";
+    stream.pos = 0;
+    rx.fill(&stream);
+    rx.clear();
+    stream.data = "def\r\n";
+    stream.pos = 0;
+    rx.fill(&stream);
+    CHECK(nextLine(&rx) == "def");
+}
+
+int main()
+{
+    testLines();
+    testChunks();
+    testOverflow();
+    testPrompt();
+    return TEST_END();
+}
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Decode and replay UART traces recorded with A9G_Trace (see src/A9G_Trace.h).
+
+  a9g_trace.py show   trace.bin                 print the trace with timestamps
+  a9g_trace.py replay trace.bin PORT [options]  send the recorded module output to PORT with the
+                                                original timing, e.g. into a board running the
+                                                library in place of the module
+  a9g_trace.py carray trace.bin [NAME]          print the trace as a C array for A9G_TraceReplay
+
+replay needs pyserial.
+"""
+
+import argparse
+import sys
+import time
+
+MAGIC = b"A9GT"
+FORMAT_VERSION = 1
+HEADER_SIZE = 6
+TX = 1
+
+
+def parse(data):
+    """Returns a list of (time_us, direction, payload) with time relative to the first record."""
+    if len(data) < HEADER_SIZE or data[:4] != MAGIC:
+        raise ValueError("not an A9G trace")
+    if data[4] != FORMAT_VERSION:
+        raise ValueError("unsupported trace version %d" % data[4])
+
+    records = []
+    pos = HEADER_SIZE
+    now = 0
+    while pos < len(data):
+        header = data[pos]
+        pos += 1
+        delta = 0
+        shift = 0
+        while pos < len(data):
+            b = data[pos]
+            pos += 1
+            delta |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        if records:
+            now += delta
+        length = header & 0x7F
+        records.append((now, header >> 7, data[pos:pos + length]))
+        pos += length
+    return records
+
+
+def show(records, out):
+    for t, direction, payload in records:
+        arrow = ">>" if direction == TX else "<<"
+        out.write("%12.6f %s %r\n" % (t / 1e6, arrow, bytes(payload)))
+
+
+def replay(records, port, baud, speed, show_tx):
+    import serial
+
+    with serial.Serial(port, baud, timeout=0) as ser:
+        start = time.monotonic()
+        for t, direction, payload in records:
+            if direction == TX:
+                continue
+            wait = start + t / 1e6 / speed - time.monotonic()
+            if wait > 0:
+                time.sleep(wait)
+            ser.write(payload)
+            if show_tx:
+                echo = ser.read(4096)
+                if echo:
+                    sys.stdout.write(">> %r\n" % echo)
+        ser.flush()
+
+
+def carray(data, name, out):
+    out.write("const uint8_t %s[%d] = {\n" % (name, len(data)))
+    for i in range(0, len(data), 16):
+        out.write("    " + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",\n")
+    out.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("show")
+    p.add_argument("trace")
+
+    p = sub.add_parser("replay")
+    p.add_argument("trace")
+    p.add_argument("port")
+    p.add_argument("--baud", type=int, default=115200)
+    p.add_argument("--speed", type=float, default=1.0, help="time scale, 2 replays twice as fast")
+    p.add_argument("--show-tx", action="store_true", help="print what the device sends back")
+
+    p = sub.add_parser("carray")
+    p.add_argument("trace")
+    p.add_argument("name", nargs="?", default="trace")
+
+    args = parser.parse_args()
+    with open(args.trace, "rb") as f:
+        data = f.read()
+    records = parse(data)
+
+    if args.command == "show":
+        show(records, sys.stdout)
+    elif args.command == "replay":
+        replay(records, args.port, args.baud, args.speed, args.show_tx)
+    else:
+        carray(data, args.name, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
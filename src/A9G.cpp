@@ -33,12 +33,99 @@
 GSM::GSM(bool debug)
     : _debug(debug), _maxWaitTimeMS(MAX_WAIT_TIME_MS)
 {
-
+    memset(_timeoutOverride, 0, sizeof(_timeoutOverride));
+    memset(&_metrics, 0, sizeof(_metrics));
+    _stateReset(&_localState);
+    memset(&_signalNow, 0, sizeof(_signalNow));
+    _signalNow.rssi = 99;
+    _signalNow.ber = 99;
+    _signalNow.creg = -1;
+#ifndef A9G_NO_MQTT
+    memset(_publishQueue, 0, sizeof(_publishQueue));
+#endif
+#ifndef A9G_NO_SMS
+    memset(_outbox, 0, sizeof(_outbox));
+    memset(_outboxBodyRefs, 0, sizeof(_outboxBodyRefs));
+    memset(_reports, 0, sizeof(_reports));
+#endif
+#ifndef A9G_NO_EVENT_LANES
+    memset(_termPriority, EVENT_PRIORITY_NORMAL, sizeof(_termPriority));
+    _termPriority[TERM_CME] = EVENT_PRIORITY_CONTROL;
+    _termPriority[TERM_CMS] = EVENT_PRIORITY_CONTROL;
+    _termPriority[TERM_CREG] = EVENT_PRIORITY_CONTROL;
+    _termPriority[TERM_CPIN] = EVENT_PRIORITY_CONTROL;
+    _termPriority[TERM_CGATT] = EVENT_PRIORITY_CONTROL;
+    _termPriority[TERM_GPSRD] = EVENT_PRIORITY_BULK;
+    _termPriority[TERM_AGPS] = EVENT_PRIORITY_BULK;
+    _termPriority[TERM_GPNT] = EVENT_PRIORITY_BULK;
+    _lanes[EVENT_PRIORITY_BULK].policy = LANE_DROP_OLDEST;
+    for (uint8_t i = 0; i < COALESCE_SLOTS; i++)
+    {
+        _coalesce[i].term_id = TERM_NONE;
+    }
+    SetCoalesce(EVENT_CREG, true);
+    SetCoalesce(EVENT_CIEV, true);
+    SetCoalesce(EVENT_CSQ, true);
+    SetCoalesce(EVENT_CGATT, true);
+#endif
+#ifndef A9G_NO_MQTT
+    memset(_dedup, 0, sizeof(_dedup));
+#endif
 }
 
+#ifndef A9G_NO_SMS
+#define SMS_TERM(name) name
+#else
+#define SMS_TERM(name) ""
+#endif
+#ifndef A9G_NO_MQTT
+#define MQTT_TERM(name) name
+#else
+#define MQTT_TERM(name) ""
+#endif
+#ifndef A9G_NO_GPS
+#define GPS_TERM(name) name
+#else
+#define GPS_TERM(name) ""
+#endif
+
+// Indexed by Term_List_t.
+const char GSM::_terms_string[TERM_MAX][12] PROGMEM = {
+    "CREG",
+    "CTZV",
+    "CIEV",
+    SMS_TERM("CPMS"),
+    SMS_TERM("CMT"),
+    SMS_TERM("CMTI"),
+    SMS_TERM("CMGL"),
+    SMS_TERM("CMGR"),
+    GPS_TERM("GPSRD"),
+    "CGATT",
+    GPS_TERM("AGPS"),
+    GPS_TERM("GPNT"),
+    MQTT_TERM("MQTTPUBLISH"),
+    SMS_TERM("CMGS"),
+    "CME ERROR",
+    "CMS ERROR",
+    "CSQ",
+    "EGMR",
+    "CCID",
+    SMS_TERM("CDS"),
+    "CGDCONT",
+    "CGACT",
+    "CPIN",
+};
+
 void GSM::init(Stream *gsm)
 {
-    _gsm = gsm;
+    _streamTransport.begin(gsm);
+    init(&_streamTransport);
+}
+
+void GSM::init(A9G_Transport *transport)
+{
+    _tap.begin(transport);
+    _gsm = &_tap;
 }
 
 void GSM::Test(char *data)
@@ -62,15 +149,17 @@ uint8_t GSM::_checkTermFromString(const char *term_str)
 {
     for (int i = 0; i < TERM_MAX; i++)
     {
-        if (!strcmp(term_str, _terms_string[i]))
+        if (pgm_read_byte(_terms_string[i]) && !strcmp_P(term_str, _terms_string[i]))
         {
+            _metrics.terms[i]++;
             return i;
         }
     }
+    _metrics.unknown_terms++;
     return TERM_NONE;
 }
 
-void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len)
+bool GSM::_processTermString(A9G_Event_t *event, char data[], int data_len)
 {
     // Serial.println("\nCore >> _processTermString(): ");
     // Serial.print("event->id: ");
@@ -80,36 +169,35 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
     // Serial.print("data_len: ");
     // Serial.println(data_len);
 
-    uint8_t comma_count = 0;
-    uint8_t message_count = 0;
-
-    if (event->id == EVENT_MQTTPUBLISH)
+    if (event->id == EVENT_CME || event->id == EVENT_CMS)
     {
-        uint8_t topic_count = 0;
-        for (int i = 0; i < data_len; i++)
+        event->error = atoi(data);
+    }
+#ifndef A9G_NO_MQTT
+    else if (event->id == EVENT_MQTTPUBLISH)
+    {
+        // <id>,<topic>,<length>,<payload>: topic and payload are handed out in place.
+        char *topic = strchr(data, ',');
+        char *length = topic ? strchr(topic + 1, ',') : NULL;
+        char *payload = length ? strchr(length + 1, ',') : NULL;
+        if (!payload)
         {
-            if (data[i] == ',' && comma_count < 3)
-            {
-                comma_count++;
-                continue;
-            }
-            if (comma_count == 1)
-            {
-                event->topic[topic_count++] = data[i];
-                // Serial.print(data[i]);
-            }
-            if(comma_count >= 3){
-                event->message[message_count++] = data[i];
-            }
+            return false;
         }
-        event->message[message_count++] = '\0';
-        event->topic[topic_count++] = '\0';
+        *length = '\0';
+        event->topic = topic + 1;
+        event->topic_len = length - event->topic;
+        event->message = payload + 1;
+        event->message_len = data + data_len - event->message;
     }
-    else if (event->id == TERM_CME)
+#endif
+    else if (event->id == EVENT_CMGS)
     {
-        event->error = atoi(data);
+        event->param1 = atoi(data);
     }
-    else if(event->id == TERM_CMTI){
+#ifndef A9G_NO_SMS
+    else if(event->id == EVENT_CMTI){
+        uint8_t comma_count = 0;
         char temp[5] = "\0";
         int j =0;
         for (int i = 0; i <= data_len; i++)
@@ -119,7 +207,7 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
                 comma_count++;
                 continue;
             }
-            if(comma_count ==1){
+            if(comma_count ==1 && j < (int)sizeof(temp) - 1){
                 temp[j++] = data[i];
             }
         }
@@ -128,34 +216,17 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
         // Serial.print("Message Index:");
         // Serial.println(temp);
 
-        delay(100);
-        ReadMessage(atoi(temp));
-
-    }
-    else if(event->id == TERM_CMGR){ //sms read 
-        char message[100] = "\0";
-        int j =0;
-        bool sms = 0;
-       
-        while(_gsm->available()){
-            char c = _gsm->read();
-            
-            if(c=='\n'){
-                sms = 1;
-                continue;
-            }
-            if(c=='\r'){
-                sms = 0;
-                event->message[j] = '\0';
-                break;
-            }
-            if(sms){
-                event->message[j++] = c;
-                // Serial.print(event->message);
-            }
-            
+        // Read later from executeCallback(): an SMS send may be waiting for its prompt right now.
+        if (_smsReadCount < SMS_READ_QUEUE_SIZE)
+        {
+            _smsReadQueue[_smsReadCount++] = atoi(temp);
         }
 
+    }
+    else if(event->id == EVENT_NEW_SMS_RECEIVED && _pduMode){ //sms read, PDU mode
+        return _processPDUMessage(event);
+    }
+    else if(event->id == EVENT_NEW_SMS_RECEIVED){ //sms read 
         uint8_t qout_count = 0;
         uint8_t number_count = 0;
         uint8_t date_time_count = 0;
@@ -169,12 +240,12 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
                 // Serial.println(qout_count);
                 continue;
             }
-            if (qout_count == 3)
+            if (qout_count == 3 && number_count < sizeof(event->number) - 1)
             {
                 event->number[number_count++] = data[i];
                 // Serial.print(event->number);
             }
-            if(qout_count == 5){
+            if(qout_count == 5 && date_time_count < sizeof(event->date_time) - 1){
                 event->date_time[date_time_count++] = data[i];
                 // Serial.print(event->date_time);
             }
@@ -182,6 +253,17 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
         event->number[number_count++] = '\0';
         event->date_time[date_time_count++] = '\0';
 
+        // The text follows on its own line. data lives in the RX buffer, so it is not used after this.
+        size_t text_len = 0;
+        const char *text = _nextLine(&text_len, 1000);
+        if (text)
+        {
+            event->message = text;
+            event->message_len = text_len;
+        }
+        event->sms_text = event->message;
+        event->sms_text_len = event->message_len;
+
         // Serial.print("Message:");
         // Serial.println(event->message);
         // Serial.print("Number:");
@@ -190,9 +272,15 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
         // Serial.println(event->date_time);
 
     }
+#endif
+    else if(event->id == EVENT_CREG){
+        event->param1 = _state->creg;
+        event->param2 = data;
+        event->param2_len = data_len;
+    }
     else if(event->id == EVENT_CSQ){
         char buffer[10] = "\0";
-        for(int i = 0; i<=data_len; i++){
+        for(int i = 0; i<=data_len && i < (int)sizeof(buffer) - 1; i++){
             if(data[i] == ','){
                 buffer[i] = '\0';
                 break;
@@ -203,1225 +291,2685 @@ void GSM::_processTermString(A9G_Event_t *event, const char data[], int data_len
         }
         event->param1 =atoi(buffer);
     }
-    else if(event->id == EVENT_IMEI){
-        strcpy(event->param2,data);
+    else if(event->id == EVENT_IMEI || event->id == EVENT_CCID || event->id == EVENT_CPIN){
+        event->param2 = data;
+        event->param2_len = data_len;
     }
-    else if(event->id == EVENT_CCID){
-        strcpy(event->param2,data);
+#ifndef A9G_NO_SMS
+    else if(event->id == EVENT_SMS_STATUS_REPORT){
+        return _processStatusReport(event, data, data_len);
     }
+#endif
+    return true;
 }
 
-void GSM::executeCallback()
+#ifndef A9G_NO_SMS
+bool GSM::_processPDUMessage(A9G_Event_t *event)
 {
-    char c;
-    int term_length = 0;
-    int term_data_count = 0;
-    bool term_started = false, term_ended = false;
-    bool term_data_started = false, term_data_ended = false;
-    char term_data[MAX_MSG_SIZE];
-    char term[MAX_TERM_SIZE];
-
-    A9G_Event_t *event = NULL;
-    event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
-
-    while (_gsm->available())
+    // +CMGR: <stat>,[<alpha>],<length>\r\n<pdu>\r\n
+    size_t hex_len;
+    const char *hex;
+    PDU_Message_t *part = (PDU_Message_t *)malloc(sizeof(PDU_Message_t));
+    if (!part)
     {
-        char c = _gsm->read();
-        // Serial.print(c);
-
-        if (c == '+' && !term_started && !term_ended)
-        {
-            // Serial.println("########## New Term!");
-            term_started = 1;
-            term_ended = 0;
-            term_data_count = 0;
-            continue;
-        }
-
-        if ((c == '=' || c == ':') && !term_ended)
-        {
-            // Serial.println("********** Term Stop!");
-            term[term_length] = '\0';
-            term_ended = 1;
-            continue;
-        }
-
-        if (term_started && !term_ended)
-        {
-            term[term_length++] = c;
-            // Serial.print("term: ");
-            // Serial.println(c);
-        }
-
-        if (term_started && term_ended && !term_data_started)
-        {
-            // Serial.print(">>>term: ");
-            // Serial.println(term);
-
-            int term_id = _checkTermFromString(term);
-            // Serial.print("term id: ");
-            // Serial.println(term_id);
+        return false;
+    }
 
-            if (term_id == TERM_NONE || term_id == TERM_MAX)
-            {
-                // Terminate these term here, we will not process these type in this function. for cemplexity issue.
-                // Serial.println("***** Terminating this term here ******");
-                term_started = 0;
-                term_ended = 0;
-                term_length = 0;
-                term_data_started = 0;
-                break;
-            }
-            else
-            {
-                term_data_started = 1;
-                // Serial.println("***** Term Accepted ******");
-                event->id = static_cast<Event_ID_t>(term_id);
-            }
-        }
-        if (term_ended && term_data_started)
+    bool dispatch = false;
+    hex = _nextLine(&hex_len, 1000);
+    if (hex && pduDecodeDeliver(hex, part))
+    {
+        uint16_t text_len = 0;
+        const char *text = _smsReassembler.add(part, &text_len);
+        if (text)
         {
-            if (c == '\r')
-            {
-                // Serial.print(">>>term data:");
-                // Serial.println(term_data);
-                term_started = 0;
-                term_ended = 0;
-                term_length = 0;
-                term_data_started = 0;
-
-                event->message[0] = '\0';
-                if (_eventCallback)
-                {
-                    _processTermString(event, term_data, term_data_count);
-                    // Serial.println("Error Callback Triggered");
-                    // Serial.print("event->id: ");
-                    // Serial.println(event->id);
-                    // Serial.print("event->param1: ");
-                    // Serial.println(event->message);
-                    
-
-
-                    _eventCallback(event); // Execute the callback function with the new random number
-                }
-
-                break;
-            }
-            else
-            {
-                term_data[term_data_count++] = c;
-            }
+            strcpy(event->number, part->number);
+            strcpy(event->date_time, part->date_time);
+            event->message = text;
+            event->message_len = text_len;
+            event->sms_text = text;
+            event->sms_text_len = text_len;
+            dispatch = true;
         }
     }
-    free(event);
-    yield();
+    free(part);
+    return dispatch;
 }
 
-bool GSM::_checkResponse(const int timeout)
+bool GSM::_processStatusReport(A9G_Event_t *event, const char data[], int data_len)
 {
-    char response[150];                    // Assuming the response won't exceed 50 characters
-    memset(response, 0, sizeof(response)); // Initialize response to all zeros
-    long int start_time = millis();
-    int idx = 0; // Index to keep track of response characters
-
-    int term_length = 0;
-    int term_data_count = 0;
-    bool term_started = false, term_ended = false;
-    bool term_data_started = false, term_data_ended = false;
-    char term_data[MAX_MSG_SIZE];
-    char term[MAX_TERM_SIZE];
-
-    A9G_Event_t *event = NULL;
-    event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+    uint8_t mr = 0;
+    uint8_t status = 0;
 
-    while ((millis() - start_time) < timeout)
+    if (_pduMode)
     {
-        while (_gsm->available())
+        // +CDS: <length>\r\n<pdu>
+        size_t hex_len;
+        const char *hex = _nextLine(&hex_len, 1000);
+        if (!hex || !pduDecodeStatusReport(hex, &mr, event->number, &status))
         {
-            char c = _gsm->read();
-            response[idx++] = c;
-            // Serial.print(c);
-
-            if (c == '+' && !term_started && !term_ended)
-            {
-                // Serial.println("########## New Term!");
-                term_started = 1;
-                term_ended = 0;
-                term_data_count = 0;
-                continue;
-            }
-
-            if ((c == ':') && !term_ended)
+            return false;
+        }
+    }
+    else
+    {
+        // +CDS: <fo>,<mr>,[<ra>],[<tora>],<scts>,<dt>,<st>
+        uint8_t field = 0;
+        uint8_t number_count = 0;
+        bool quoted = false;
+        for (int i = 0; i < data_len; i++)
+        {
+            if (data[i] == '"')
             {
-                // Serial.println("********** Term Stop!");
-                term[term_length] = '\0';
-                term_ended = 1;
+                quoted = !quoted;
                 continue;
             }
-
-            if (term_started && !term_ended)
-            {
-                if (c == '\r')
-                {
-                    term_started = 0;
-                    term_length = 0;
-                }
-                else
-                {
-                    term[term_length++] = c;
-                }
-
-                // Serial.print("term: ");
-                // Serial.println(c);
-            }
-
-            if (term_started && term_ended && !term_data_started)
-            {
-                // Serial.print(">>>term: \"");
-                // Serial.print(term);
-                // Serial.println("\"");
-
-                int term_id = _checkTermFromString(term);
-                // Serial.print("term id: ");
-                // Serial.println(term_id);
-
-                if (term_id == TERM_GPSRD || term_id == TERM_CMGS || term_id == TERM_CMGL || term_id == TERM_CIEV || term_id == TERM_NONE || term_id == TERM_MAX)
-                {
-                    // Terminate these term here, we will not process these type in this function. for cemplexity issue.
-                    // Serial.println("***** Terminating this term here ******");
-                    term_started = 0;
-                    term_ended = 0;
-                    term_length = 0;
-                    term_data_started = 0;
-                }
-                else
-                {
-                    term_data_started = 1;
-                    // Serial.println("***** Term Accepted ******");
-                    event->id = static_cast<Event_ID_t>(term_id);
-                }
-            }
-            if (term_ended && term_data_started)
+            if (data[i] == ',' && !quoted)
             {
-                if (c == '\r')
+                field++;
+                if (field == 1)
                 {
-                    // Serial.print(">>>term data:");
-                    // Serial.println(term_data);
-                    term_started = 0;
-                    term_ended = 0;
-                    term_length = 0;
-                    term_data_started = 0;
-                    event->message[0] = '\0';
-                    if (_eventCallback)
-                    {
-                        _processTermString(event, term_data, term_data_count);
-                        // Serial.println("Error Callback Triggered");
-                        // Serial.print("event->id: ");
-                        // Serial.println(event->id);
-                        // Serial.print("event->param1: ");
-                        // Serial.println(event->param1);
-
-                        _eventCallback(event); // Execute the callback function with the new random number
-                    }
-
+                    mr = atoi(data + i + 1);
                 }
-                else
+                else if (field == 6)
                 {
-                    term_data[term_data_count++] = c;
+                    status = atoi(data + i + 1);
                 }
+                continue;
             }
-
-            // Check if "OK" is present in the received characters
-            if (strstr(response, "OK"))
-            {
-                free(event);
-                return true;
-            }
-            if (idx >= sizeof(response) - 1)
+            if (field == 2 && number_count < sizeof(event->number) - 1)
             {
-                Serial.println("Response buffer overflow!");
-                free(event);
-                return false;
+                event->number[number_count++] = data[i];
             }
         }
-    }
-    free(event);
-    return false;
-}
-
-bool GSM::bIsReady()
-{
-    _gsm->println("AT");
-    if (_checkResponse(2000))
-    {
-        if (_debug)
+        event->number[number_count] = '\0';
+        if (field < 6)
         {
-            Serial.println(F("GSM Ready"));
-            return true;
+            return false;
         }
     }
-    else
-        return false;
+
+    event->param1 = _reportLookup(mr);
+    event->error = status;
+    return true;
 }
 
+#endif
 
-bool GSM::waitForReady()
+char *GSM::_nextLine(size_t *len, unsigned long timeout)
 {
-    char responseBuffer[100]; // Adjust the size as per your needs
-    int index = 0;
-
-
-    int term_length = 0;
-    int term_data_count = 0;
-    bool term_started = false, term_ended = false;
-    bool term_data_started = false, term_data_ended = false;
-    char term_data[MAX_MSG_SIZE];
-    char term[MAX_TERM_SIZE];
-
-    A9G_Event_t *event = NULL;
-    event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+    unsigned long start_time = millis();
+    char *line;
 
-
-    _gsm->println("AT");
-    // need make this function break until it gets ready command
-    while (1)
+    while (millis() - start_time < timeout)
     {
-        if(_gsm->available())
+        unsigned long elapsed = millis() - start_time;
+        if (!_rx.fill(_gsm) && elapsed < timeout)
         {
-            char c = _gsm->read();
-            responseBuffer[index++] = c;
-            // Serial.print(responseBuffer);
-            // Serial.print(c);
-
-
-            if (c == '+' && !term_started && !term_ended)
-            {
-                // Serial.println("########## New Term!");
-                term_started = 1;
-                term_ended = 0;
-                term_data_count = 0;
-                continue;
-            }
-
-            if ((c == ':') && !term_ended)
-            {
-                // Serial.println("********** Term Stop!");
-                term[term_length] = '\0';
-                term_ended = 1;
-                continue;
-            }
-
-            if (term_started && !term_ended)
-            {
-                if (c == '\r')
-                {
-                    term_started = 0;
-                    term_length = 0;
-                }
-                else
-                {
-                    term[term_length++] = c;
-                }
-                // Serial.print("term: ");
-                // Serial.println(c);
-            }
-
-            if (term_started && term_ended && !term_data_started)
-            {
-                // Serial.print(">>>term: ");
-                // Serial.println(term);
-
-                int term_id = _checkTermFromString(term);
-                // Serial.print("term id: ");
-                // Serial.println(term_id);
-
-                if (term_id == TERM_GPSRD || term_id == TERM_CMGS || term_id == TERM_CMGL || term_id == TERM_CMGR || term_id == TERM_CIEV || term_id == TERM_NONE || term_id == TERM_MAX)
-                {
-                    // Terminate these term here, we will not process these type in this function. for cemplexity issue.
-                    // Serial.println("***** Terminating this term here ******");
-                    term_started = 0;
-                    term_ended = 0;
-                    term_length = 0;
-                    term_data_started = 0;
-                }
-                else
-                {
-                    term_data_started = 1;
-                    // Serial.println("***** Term Accepted ******");
-                    event->id = static_cast<Event_ID_t>(term_id);
-                }
-            }
-            if (term_ended && term_data_started)
-            {
-                if (c == '\r')
-                {
-                    // Serial.print(">>>term data:");
-                    Serial.println(term_data);
-                    term_started = 0;
-                    term_ended = 0;
-                    term_length = 0;
-                    term_data_started = 0;
-                    if (_eventCallback)
-                    {
-                        _processTermString(event, term_data, term_data_count);
-                        // Serial.println("Error Callback Triggered");
-                        // Serial.print("event->id: ");
-                        // Serial.println(event->id);
-                        // Serial.print("event->param1: ");
-                        // Serial.println(event->param1);
-
-                        _eventCallback(event); // Execute the callback function with the new random number
-                    }
-                }
-                else
-                {
-                    term_data[term_data_count++] = c;
-                }
-            }
-
-
-            if (c == '\n')
-            {
-                responseBuffer[index] = '\0'; // Null-terminate the string
-
-                if (strstr(responseBuffer, "READY") != NULL)
-                {
-                    return true;
-                }
-                if (strstr(responseBuffer, "NO SIM CARD") != NULL)
-                {
-                    Serial.println("NO SIM CARD");
-                }
-
-                index = 0; // Reset index for next response
-            }
-
-            if (index >= sizeof(responseBuffer) - 1)
-            {
-                index = 0; // Reset index if buffer is full
-            }
+            _tap.wait(timeout - elapsed);
+        }
+        line = _rx.readLine(len);
+        if (line)
+        {
+            return line;
         }
     }
-
-    return false;
-}
-
-// AT+CSQ: Check signal strength (in dBm).
-// AT+CCID: Read the ICCID (Integrated Circuit Card Identifier) of the SIM card.
-
-void GSM::ReadIMEI(){
-    _gsm->println("AT+EGMR=2,7");
-    _checkResponse(1000);
-}
-/**
- * @brief 
- * @todo need to implement: issue.
- * 
- */
-void GSM::ReadCSQ(){
-    _gsm->println("AT+CSQ");
-    _checkResponse(1000);
-}
-void GSM::ReadCCID(){
-    _gsm->println("AT+CCID");
-    _checkResponse(1000);
+    return NULL;
 }
 
-bool GSM::IsGPRSAttached()
+uint8_t GSM::_termFromLine(char line[], char **data, int *data_len)
 {
-    _gsm->println("AT+CGATT?");
-    if (_checkResponse(2000))
+    // +<NAME>:<data>
+    bool resumed = _resumed;
+    _resumed = false;
+    char *name = line[0] == '+' ? line + 1 : line;
+    if (name == line && !resumed)
     {
-        return true;
+        return TERM_NONE;
     }
-    else
+    char *colon = strchr(name, ':');
+    if (!colon)
     {
-        return false;
+        return TERM_NONE;
     }
+    *colon = '\0';
+    uint8_t term_id = _checkTermFromString(name);
+    *data = colon + 1;
+    *data_len = strlen(colon + 1);
+    return term_id;
 }
 
-bool GSM::AttachToGPRS()
+static void _clearEvent(A9G_Event_t *event, Event_ID_t id)
 {
-    _gsm->println("AT+CGATT=1");
-    if (_checkResponse(2000))
-    {
-        return true;
-    }
-    else
-        return false;
+    event->id = id;
+    event->error = 0;
+    event->message = "";
+    event->message_len = 0;
+    event->topic = "";
+    event->topic_len = 0;
+    event->number[0] = '\0';
+    event->date_time[0] = '\0';
+    event->param1 = 0;
+    event->param2 = "";
+    event->param2_len = 0;
+    event->param3[0] = '\0';
+    event->sms_text = "";
+    event->sms_text_len = 0;
 }
 
-bool GSM::DetachToGPRS()
+#if !defined(A9G_NO_EVENT_LANES) || !defined(A9G_NO_MQTT)
+// FNV-1a
+static uint32_t _hash(const char data[], size_t len)
 {
-    _gsm->println("AT+CGATT=0");
-    if (_checkResponse(2000))
-    {;
-        return true;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
     }
-    else
-        return false;
+    return hash;
 }
+#endif
 
-bool GSM::SetAPN(const char pdp_type[], const char apn[])
+void GSM::_dispatchTerm(A9G_Event_t *event, uint8_t term_id, char data[], int data_len)
 {
-    _gsm->print("AT+CGDCONT=1,\"");
-    _gsm->print(pdp_type);
-    _gsm->print("\",\"");
-    _gsm->print(apn);
-    _gsm->println("\"");
+    _trackTerm(term_id, data);
+    _deliverTerm(event, term_id, data, data_len);
+}
 
-    if (_checkResponse(2000))
-    {
-        return true;
-    }
-    else
-        return false;
+void GSM::_trackTerm(uint8_t term_id, const char data[])
+{
+    _stateOnTerm(term_id, data);
+    _readyOnTerm(term_id, data);
+    _signalOnTerm(term_id, data);
 }
 
-bool GSM::ActivatePDP()
+void GSM::_deliverTerm(A9G_Event_t *event, uint8_t term_id, char data[], int data_len)
 {
-    _gsm->println("AT+CGACT=1,1");
-    if (_checkResponse(2000))
+#ifndef A9G_NO_MQTT
+    if (term_id == TERM_MQTTPUBLISH && _eventCallback && _mqttDuplicate(data, data_len))
     {
-        return true;
+        return;
+    }
+#endif
+    _clearEvent(event, static_cast<Event_ID_t>(term_id));
+    if (_eventCallback)
+    {
+        if (_processTermString(event, data, data_len))
+        {
+            _eventCallback(event);
+        }
     }
-    else
-        return false;
 }
 
-
-bool GSM::ConnectToBroker(const char broker[], int port, const char user[], const char pass[], const char id[], uint8_t keep_alive, uint16_t clean_session)
+#ifndef A9G_NO_EVENT_LANES
+bool GSM::_coalesceOnTerm(uint8_t term_id, const char data[], size_t len)
 {
-    _gsm->print("AT+MQTTCONN=\"");
-    _gsm->print(broker);
-    _gsm->print("\",");
-    _gsm->print(port);
-    _gsm->print(",\"");
-    _gsm->print(id);
-    _gsm->print("\",");
-    _gsm->print(keep_alive);
-    _gsm->print(",");
-    _gsm->print(clean_session);
-    _gsm->print(",\"");
-    _gsm->print(user);
-    _gsm->print("\",\"");
-    _gsm->print(pass);
-    _gsm->println("\"");
-
-    if (_checkResponse(2000))
+    if (!_coalesceWindowMS || len >= COALESCE_DATA_SIZE)
     {
+        return false;
+    }
+    for (uint8_t i = 0; i < COALESCE_SLOTS; i++)
+    {
+        Coalesce_Slot_t *slot = &_coalesce[i];
+        if (slot->term_id != term_id)
+        {
+            continue;
+        }
+        if (slot->pending)
+        {
+            _coalesced++;
+        }
+        else
+        {
+            slot->pending = true;
+            slot->first_ms = millis();
+        }
+        memcpy(slot->data, data, len);
+        slot->data[len] = '\0';
+        slot->len = len;
         return true;
     }
-    else
-        return false;
+    return false;
 }
 
-bool GSM::ConnectToBroker(const char broker[], int port, const char id[], uint8_t keep_alive, uint16_t clean_session)
+void GSM::_coalescePoll()
 {
-    _gsm->print("AT+MQTTCONN=\"");
-    _gsm->print(broker);
-    _gsm->print("\",");
-    _gsm->print(port);
-    _gsm->print(",\"");
-    _gsm->print(id);
-    _gsm->print("\",");
-    _gsm->print(keep_alive);
-    _gsm->print(",");
-    _gsm->println(clean_session);
+    for (uint8_t i = 0; i < COALESCE_SLOTS; i++)
+    {
+        Coalesce_Slot_t *slot = &_coalesce[i];
+        if (!slot->pending || slot->term_id >= TERM_MAX || millis() - slot->first_ms < _coalesceWindowMS)
+        {
+            continue;
+        }
+        uint32_t hash = _hash(slot->data, slot->len);
+        if (slot->last_ms && hash == slot->last_hash && slot->first_ms - slot->last_ms < _coalesceWindowMS)
+        {
+            // Same value as the last delivery, and it started within a window of it.
+            slot->pending = false;
+            _coalesced++;
+            continue;
+        }
+        A9G_EventLane *lane = &_lanes[_termPriority[slot->term_id]];
+        if (lane->policy != LANE_DROP_OLDEST && (size_t)EVENT_LANE_RECORD(slot->len) > lane->room())
+        {
+            // Stays pending until the lane has room; the latest status must not be lost.
+            continue;
+        }
+        lane->push(slot->term_id, slot->data, slot->len);
+        slot->pending = false;
+        slot->last_hash = hash;
+        slot->last_ms = millis() | 1; // 0 means nothing delivered yet
+    }
+}
 
-    if (_checkResponse(2000))
+char *GSM::_pullLine(size_t *len)
+{
+    char *line = _rx.readLine(len);
+    if (!line && _rx.fill(_gsm))
     {
-        return true;
+        line = _rx.readLine(len);
     }
-    else
-        return false;
+    return line;
 }
 
-bool GSM::ConnectToBroker(const char broker[], int port)
+bool GSM::_termHasBody(uint8_t term_id)
 {
-    char id[10] = "\0";
-    sprintf(id, "%d", random(10000, 100000));
-    _gsm->print("AT+MQTTCONN=\"");
-    _gsm->print(broker);
-    _gsm->print("\",");
-    _gsm->print(port);
-    _gsm->print(",\"");
-    _gsm->print(id);
-    _gsm->print("\",");
-    _gsm->print(120);
-    _gsm->print(",");
-    _gsm->println(0);
+#ifndef A9G_NO_SMS
+    // _processTermString() reads the following line for these.
+    return term_id == TERM_CMGR || (term_id == TERM_CDS && _pduMode);
+#else
+    (void)term_id;
+    return false;
+#endif
+}
 
-    if (_checkResponse(2000))
+Event_Priority_t GSM::_eventPriority(uint8_t term_id, const char data[])
+{
+#ifndef A9G_NO_MQTT
+    if (term_id == TERM_MQTTPUBLISH && _controlTopic)
     {
-        return true;
+        // <id>,<topic>,<length>,<payload>
+        const char *topic = strchr(data, ',');
+        if (topic && !strncmp(topic + 1, _controlTopic, strlen(_controlTopic)))
+        {
+            return EVENT_PRIORITY_CONTROL;
+        }
     }
-    else
-        return false;
+#else
+    (void)data;
+#endif
+    return static_cast<Event_Priority_t>(_termPriority[term_id]);
 }
 
-bool GSM::DisconnectBroker()
+bool GSM::_lanesBlocked()
 {
-    _gsm->println("AT+MQTTDISCONN");
-    if (_checkResponse(2000))
+    for (uint8_t i = 0; i < EVENT_PRIORITY_MAX; i++)
     {
-        return true;
+        if (_lanes[i].policy == LANE_BLOCK && _lanes[i].room() < EVENT_LANE_RECORD(RX_BUFFER_SIZE))
+        {
+            return true;
+        }
     }
-    else
-        return false;
+    return false;
 }
-bool GSM::SubscribeToTopic(const char topic[], uint8_t qos, unsigned long timeout)
-{
-    _gsm->print("AT+MQTTSUB=\"");
-    _gsm->print(topic);
-    _gsm->print("\",");
-    _gsm->print(qos);
-    _gsm->print(",");
-    _gsm->println(timeout);
 
-    if (_checkResponse(2000))
+bool GSM::_laneDispatch()
+{
+    for (uint8_t i = 0; i < EVENT_PRIORITY_MAX; i++)
     {
-        Serial.printf("Subscribe To Topic:\"%s\"  success\n", topic);
+        uint8_t term_id;
+        size_t len;
+        char *data = _lanes[i].front(&term_id, &len);
+        if (!data)
+        {
+            continue;
+        }
+        // The record is copied out and popped first: the callback may call executeCallback() again,
+        // which must see the next record rather than deliver this one twice.
+        A9G_Event_t *event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t) + len + 1);
+        if (!event)
+        {
+            return false;
+        }
+        char *copy = (char *)(event + 1);
+        memcpy(copy, data, len + 1);
+        _lanes[i].pop();
+        _deliverTerm(event, term_id, copy, len);
+        free(event);
         return true;
     }
-    else
-        return false;
+    return false;
 }
-bool GSM::SubscribeToTopic(const char topic[])
-{
-    _gsm->print("AT+MQTTSUB=\"");
-    _gsm->print(topic);
-    _gsm->print("\",");
-    _gsm->print(1);
-    _gsm->print(",");
-    _gsm->println(0);
 
-    if (_checkResponse(2000))
+void GSM::SetEventPriority(Event_ID_t id, Event_Priority_t priority)
+{
+    if ((uint8_t)id < TERM_MAX && priority < EVENT_PRIORITY_MAX)
     {
-        Serial.printf("Subscribe To Topic:\"%s\"  success\n", topic);
-        return true;
+        _termPriority[id] = priority;
     }
-    else
-        return false;
 }
 
-bool GSM::UnsubscribeToTopic(const char topic[])
+bool GSM::SetCoalesce(Event_ID_t id, bool enable)
 {
-    _gsm->print("AT+MQTTUNSUB=\"");
-    _gsm->print(topic);
-    _gsm->println("\"");
-    if (_checkResponse(2000))
+    Coalesce_Slot_t *free_slot = nullptr;
+    for (uint8_t i = 0; i < COALESCE_SLOTS; i++)
+    {
+        Coalesce_Slot_t *slot = &_coalesce[i];
+        if (slot->term_id == id)
+        {
+            if (!enable)
+            {
+                if (slot->pending)
+                {
+                    // The latest status goes out now rather than being lost with the slot.
+                    _lanes[_termPriority[id]].push(id, slot->data, slot->len);
+                }
+                slot->pending = false;
+                slot->term_id = TERM_NONE;
+            }
+            return true;
+        }
+        if (slot->term_id == TERM_NONE && !free_slot)
+        {
+            free_slot = slot;
+        }
+    }
+    if (!enable)
     {
-        Serial.printf("Unsubscribe To Topic:\"%s\"  success\n", topic);
         return true;
     }
-    else
+    if (!free_slot || (uint8_t)id >= TERM_MAX)
+    {
         return false;
+    }
+    memset(free_slot, 0, sizeof(Coalesce_Slot_t));
+    free_slot->term_id = id;
+    return true;
 }
 
+void GSM::SetCoalesceWindow(unsigned long window_ms)
+{
+    _coalesceWindowMS = window_ms;
+}
 
-bool GSM::PublishToTopic(const char topic[], const char msg[])
+uint32_t GSM::GetCoalescedCount()
 {
-    _gsm->print("AT+MQTTPUB=\"");
-    _gsm->print(topic);
-    _gsm->print("\",\"");
-    _gsm->print(msg);
-    _gsm->println("\",2,0,0");
+    return _coalesced;
+}
 
-    if (_checkResponse(2000))
+void GSM::SetLanePolicy(Event_Priority_t priority, Lane_Policy_t policy)
+{
+    if (priority < EVENT_PRIORITY_MAX)
     {
-        return true;
+        _lanes[priority].policy = policy;
     }
-    else
-        return false;
 }
 
+uint32_t GSM::GetLaneDrops(Event_Priority_t priority)
+{
+    return priority < EVENT_PRIORITY_MAX ? _lanes[priority].dropped : 0;
+}
 
+#ifndef A9G_NO_MQTT
+void GSM::SetControlTopic(const char prefix[])
+{
+    _controlTopic = prefix;
+}
+#endif
+#endif
 
+void GSM::executeCallback()
+{
+    char *line;
+    size_t len;
+
+    _readyPoll();
+    _signalPoll();
+#ifndef A9G_NO_MQTT
+    _publishPoll();
+#endif
+#ifndef A9G_NO_SMS
+    _smsCheckTimeout();
+    _outboxPoll();
+    _smsReadPoll();
+#endif
+    _rx.fill(_gsm);
+
+#ifndef A9G_NO_EVENT_LANES
+    // Lines go into the priority lanes as they arrive and one event is delivered per call, so a
+    // control event does not queue up behind a flood of GPS or MQTT lines.
+    bool delivered = false;
+    for (uint8_t pulled = 0; pulled < EVENT_PULL_LINES && !_lanesBlocked() && (line = _pullLine(&len)) != nullptr; pulled++)
+#else
+    // One term per call keeps the time spent in here bounded, the rest waits in the RX buffer.
+    while ((line = _rx.readLine(&len)) != nullptr)
+#endif
+    {
+        _readyOnLine(line);
+        int error;
+        AT_Status_t status = _finalResultCode(line, &error);
+        if (status != AT_TIMEOUT)
+        {
+            _asyncOnFinal(status, error);
+        }
 
+        char *data;
+        int data_len;
+        uint8_t term_id = _termFromLine(line, &data, &data_len);
+        if (term_id == TERM_NONE)
+        {
+            continue;
+        }
 
+#ifndef A9G_NO_SMS
+        _smsOnTerm(term_id, data);
+#endif
 
-bool GSM::ActivateTE()
-{
-    _gsm->println(F("AT+CNMI=0,1,0,0,0"));
-    if (_checkResponse(2000))
+#ifndef A9G_NO_EVENT_LANES
+        if (!_eventCallback || !_termHasBody(term_id))
+        {
+            _trackTerm(term_id, data);
+            if (_eventCallback && !_coalesceOnTerm(term_id, data, data_len))
+            {
+                _lanes[_eventPriority(term_id, data)].push(term_id, data, data_len);
+            }
+            continue;
+        }
+        delivered = true;
+#endif
+        A9G_Event_t *event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+        if (event)
+        {
+            _dispatchTerm(event, term_id, data, data_len);
+            free(event);
+        }
+        break;
+    }
+#ifndef A9G_NO_EVENT_LANES
+    _coalescePoll();
+    if (!delivered)
     {
-        return true;
+        _laneDispatch();
     }
-    else
-        return false;
+#endif
+
+#ifndef A9G_NO_SMS
+    _smsCheckPrompt();
+#endif
+    yield();
 }
 
-bool GSM::SetFormatReading(bool mode)
+AT_Status_t GSM::_finalResultCode(const char line[], int *error)
 {
-    _gsm->print(F("AT+CMGF="));
-    _gsm->println(mode);
-    if (_checkResponse(2000))
+    if (!strcmp(line, "OK"))
     {
-        return true;
+        return AT_OK;
     }
-    else
-        return false;
+    if (!strcmp(line, "ERROR"))
+    {
+        return AT_ERROR;
+    }
+    if (!strncmp(line, "+CME ERROR:", 11))
+    {
+        *error = atoi(line + 11);
+        return AT_CME_ERROR;
+    }
+    if (!strncmp(line, "+CMS ERROR:", 11))
+    {
+        *error = atoi(line + 11);
+        return AT_CMS_ERROR;
+    }
+    return AT_TIMEOUT; // not a final result code
 }
 
-bool GSM::SetMessageStorageUnit()
+// Timeouts used until enough latency samples are collected, indexed by AT_Command_t.
+static const uint16_t _default_timeout_ms[CMD_MAX] PROGMEM = {
+    2000,  // CMD_AT
+    1000,  // CMD_CSQ
+    1000,  // CMD_EGMR
+    1000,  // CMD_CCID
+    2000,  // CMD_CGATT_READ
+    10000, // CMD_CGATT
+    2000,  // CMD_CGDCONT
+    10000, // CMD_CGACT
+    10000, // CMD_MQTTCONN
+    5000,  // CMD_MQTTDISCONN
+    5000,  // CMD_MQTTSUB
+    5000,  // CMD_MQTTUNSUB
+    5000,  // CMD_MQTTPUB
+    2000,  // CMD_CNMI
+    2000,  // CMD_CMGF
+    2000,  // CMD_CPMS
+    2000,  // CMD_CSMP
+    2000,  // CMD_SLEEP
+    2000,  // CMD_CREG_READ
+    2000,  // CMD_CGDCONT_READ
+    2000,  // CMD_CGACT_READ
+    2000,  // CMD_CREG
+    30000, // CMD_HTTPGET
+    30000, // CMD_HTTPPOST
+    2000,  // CMD_IFC
+};
+
+void GSM::SetCommandTimeout(AT_Command_t cmd, unsigned long timeout_ms)
 {
-    _gsm->println(F("AT+CPMS=\"ME\",\"ME\",\"ME\""));
-    if (_checkResponse(2000))
+    if (cmd < CMD_MAX)
     {
-        return true;
+        _timeoutOverride[cmd] = timeout_ms;
     }
-    else
-        return false;
 }
 
-void GSM::CheckMessageStorageUnit(){
-    _gsm->println(F("AT+CPBS?"));
+unsigned long GSM::GetCommandTimeout(AT_Command_t cmd)
+{
+    if (cmd >= CMD_MAX)
+    {
+        return _maxWaitTimeMS;
+    }
+    if (_timeoutOverride[cmd])
+    {
+        return _timeoutOverride[cmd];
+    }
+    if (_latency.samples(cmd) < ADAPTIVE_TIMEOUT_MIN_SAMPLES)
+    {
+        return pgm_read_word(&_default_timeout_ms[cmd]);
+    }
+
+    unsigned long timeout = _latency.percentile(cmd, 99) + ADAPTIVE_TIMEOUT_MARGIN_MS;
+    if (timeout < ADAPTIVE_TIMEOUT_MIN_MS)
+    {
+        timeout = ADAPTIVE_TIMEOUT_MIN_MS;
+    }
+    if (timeout > ADAPTIVE_TIMEOUT_MAX_FACTOR * (unsigned long)pgm_read_word(&_default_timeout_ms[cmd]))
+    {
+        timeout = ADAPTIVE_TIMEOUT_MAX_FACTOR * (unsigned long)pgm_read_word(&_default_timeout_ms[cmd]);
+    }
+    if (timeout > _maxWaitTimeMS)
+    {
+        timeout = _maxWaitTimeMS;
+    }
+    return timeout;
 }
 
+AT_Result_t GSM::_checkResponse(AT_Command_t cmd)
+{
+    unsigned long start_time = millis();
+    unsigned long timeout = GetCommandTimeout(cmd);
+    AT_Result_t result = {AT_TIMEOUT, 0, 0};
+    char *line;
+    size_t len;
 
-void GSM::ReadMessage(uint8_t index){
-    _gsm->print("AT+CMGR=");
-    _gsm->println(index);
-}
+    A9G_Event_t *event = NULL;
+    event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
 
-void GSM::DeleteMessage(uint8_t index,Message_Type_t type){
-    _gsm->print(F("AT+CMGD="));
-    _gsm->print(index);
-    _gsm->print(F(","));
-    _gsm->println(type);
+    while ((millis() - start_time) < timeout)
+    {
+        unsigned long elapsed = millis() - start_time;
+        if (!_rx.fill(_gsm) && elapsed < timeout)
+        {
+            // Sleeps on the UART event queue with A9G_UartTransport, returns at once on a Stream.
+            _tap.wait(timeout - elapsed);
+        }
+#ifndef A9G_NO_SMS
+        // An SMS started from a callback during this command still needs its prompt answered.
+        _smsCheckPrompt();
+#endif
+        while ((line = _rx.readLine(&len)) != nullptr)
+        {
+            // Serial.println(line);
+            _readyOnLine(line);
+            result.status = _finalResultCode(line, &result.error);
+
+            char *data;
+            int data_len;
+            uint8_t term_id = _termFromLine(line, &data, &data_len);
+#ifndef A9G_NO_SMS
+            if (_smsOnTerm(term_id, data) && term_id == TERM_CMS)
+            {
+                // The +CMS ERROR ends the SMS in flight, not this command.
+                result.status = AT_TIMEOUT;
+                result.error = 0;
+            }
+#endif
+            // Terminate these term here, we will not process these type in this function. for cemplexity issue.
+            if (event && term_id != TERM_GPSRD && term_id != TERM_CMGS && term_id != TERM_CMGL && term_id != TERM_CIEV && term_id != TERM_NONE && term_id != TERM_MAX)
+            {
+                _dispatchTerm(event, term_id, data, data_len);
+            }
+
+            if (result.status != AT_TIMEOUT && _asyncOnFinal(result.status, result.error))
+            {
+                // Belongs to a background poll sent before this command.
+                result.status = AT_TIMEOUT;
+                result.error = 0;
+            }
+            else if (result.status != AT_TIMEOUT)
+            {
+                result.latency_ms = millis() - start_time;
+                _lastCommandMS = millis();
+                _latency.record(cmd, result.latency_ms);
+                _countResult(result);
+                free(event);
+                _lastResult = result;
+                return result;
+            }
+        }
+    }
+    free(event);
+    result.latency_ms = millis() - start_time;
+    _lastCommandMS = millis();
+    _recordTimeout(cmd, result.latency_ms);
+    _countResult(result);
+    _lastResult = result;
+    return result;
 }
 
-//still some issue did get responce poperly
-bool GSM::bSendMessage(const char number[], const char message[])
+void GSM::_recordTimeout(AT_Command_t cmd, unsigned long latency_ms)
 {
-    _gsm->println(F("AT+CMGF=1"));
-    delay(100);
-    _gsm->print(F("AT+CMGS=\""));
-    _gsm->print(number);
-    _gsm->print(F("\"\r\n"));
-    delay(100);
-    _gsm->print(message);
-    _gsm->write(0x1a);
-    delay(100);
-    _gsm->println("AT");
-
+    // A timeout is a censored sample. It is kept at the default (or override) so that repeated
+    // timeouts do not push the learned limit up step by step.
+    if (cmd < CMD_MAX)
+    {
+        unsigned long base = _timeoutOverride[cmd] ? _timeoutOverride[cmd] : pgm_read_word(&_default_timeout_ms[cmd]);
+        latency_ms = latency_ms < base ? latency_ms : base;
+    }
+    _latency.record(cmd, latency_ms);
+}
 
-    if(_checkResponse(2000)){
-        return true;
+void GSM::_countResult(const AT_Result_t &result)
+{
+    _metrics.commands++;
+    _metrics.blocked_ms += result.latency_ms;
+    if (result.status == AT_TIMEOUT)
+    {
+        _metrics.command_timeouts++;
     }
-    else{
-        return false;
+    else if (result.status != AT_OK)
+    {
+        _metrics.command_errors++;
     }
 }
 
-void GSM::vSendMessage(const char number[], const char message[])
+void GSM::GetMetrics(Metrics_t *metrics)
 {
-
-    _gsm->print(F("AT+CMGS=\""));
-    _gsm->print(number);
-    _gsm->print(F("\"\r\n"));
-    delay(100);
-    _gsm->print(message);
-    _gsm->println((char)26);
-    delay(100);
-
-    _gsm->println("AT");
+    *(Counters_t *)metrics = _metrics;
+    metrics->bytes_read = _tap.bytesRead;
+    metrics->bytes_written = _tap.bytesWritten;
+    metrics->overflows = _rx.overflows;
+    metrics->rx_overruns = _tap.overruns() - _overrunsBase;
+#ifndef A9G_NO_LATENCY
+    for (uint8_t i = 0; i < CMD_MAX; i++)
+    {
+        memcpy(metrics->latency[i], _latency.histogram((AT_Command_t)i), LATENCY_BUCKETS);
+    }
+#endif
 }
 
+static size_t _putVarint(uint8_t buffer[], size_t size, size_t len, uint32_t value)
+{
+    do
+    {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        if (len < size)
+        {
+            buffer[len] = b | (value ? 0x80 : 0x00);
+        }
+        len++;
+    } while (value);
+    return len;
+}
 
-void GSM::errorPrintCME(int ret)
+size_t GSM::SerializeMetrics(uint8_t buffer[], size_t size)
 {
-    switch (ret)
+    Metrics_t *m = (Metrics_t *)malloc(sizeof(Metrics_t));
+    if (!m)
     {
-    case PHONE_FAILURE:
-        Serial.printf("PHONE_FAILURE\n");
-        break;
-    case NO_CONNECT_PHONE:
-        Serial.printf("NO_CONNECT_PHONE\n");
-        break;
-    case PHONE_ADAPTER_LINK_RESERVED:
-        Serial.printf("PHONE_ADAPTER_LINK_RESERVED\n");
-        break;
-    case OPERATION_NOT_ALLOWED:
-        Serial.printf("OPERATION_NOT_ALLOWED\n");
-        break;
-    case OPERATION_NOT_SUPPORTED:
-        Serial.printf("OPERATION_NOT_SUPPORTED\n");
-        break;
-    case PHSIM_PIN_REQUIRED:
-        Serial.printf("PHSIM_PIN_REQUIRED\n");
-        break;
-    case PHFSIM_PIN_REQUIRED:
-        Serial.printf("PHFSIM_PIN_REQUIRED\n");
-        break;
-    case PHFSIM_PUK_REQUIRED:
-        Serial.printf("PHFSIM_PUK_REQUIRED\n");
-        break;
-    case SIM_NOT_INSERTED:
-        Serial.printf("SIM_NOT_INSERTED\n");
-        break;
-    case SIM_PIN_REQUIRED:
-        Serial.printf("SIM_PIN_REQUIRED\n");
-        break;
-    case SIM_PUK_REQUIRED:
-        Serial.printf("SIM_PUK_REQUIRED\n");
-        break;
-    case SIM_FAILURE:
-        Serial.printf("SIM_FAILURE\n");
-        break;
-    case SIM_BUSY:
-        Serial.printf("SIM_BUSY\n");
-        break;
-    case SIM_WRONG:
-        Serial.printf("SIM_WRONG\n");
-        break;
-    case INCORRECT_PASSWORD:
-        Serial.printf("INCORRECT_PASSWORD\n");
-        break;
-    case SIM_PIN2_REQUIRED:
-        Serial.printf("SIM_PIN2_REQUIRED\n");
-        break;
-    case SIM_PUK2_REQUIRED:
-        Serial.printf("SIM_PUK2_REQUIRED\n");
-        break;
-    case MEMORY_FULL:
-        Serial.printf("MEMORY_FULL\n");
-        break;
-    case INVALID_INDEX:
-        Serial.printf("INVALID_INDEX\n");
-        break;
-    case NOT_FOUND:
-        Serial.printf("NOT_FOUND\n");
-        break;
-    case MEMORY_FAILURE:
-        Serial.printf("MEMORY_FAILURE\n");
-        break;
-    case TEXT_LONG:
-        Serial.printf("TEXT_LONG\n");
-        break;
-    case INVALID_CHAR_INTEXT:
-        Serial.printf("INVALID_CHAR_INTEXT\n");
-        break;
-    case DAIL_STR_LONG:
-        Serial.printf("DAIL_STR_LONG\n");
-        break;
-    case INVALID_CHAR_INDIAL:
-        Serial.printf("INVALID_CHAR_INDIAL\n");
-        break;
-    case NO_NET_SERVICE:
-        Serial.printf("NO_NET_SERVICE\n");
-        break;
-    case NETWORK_TIMOUT:
-        Serial.printf("NETWORK_TIMOUT\n");
-        break;
-    case NOT_ALLOW_EMERGENCY:
-        Serial.printf("NOT_ALLOW_EMERGENCY\n");
-        break;
-    case NET_PER_PIN_REQUIRED:
-        Serial.printf("NET_PER_PIN_REQUIRED\n");
-        break;
-    case NET_PER_PUK_REQUIRED:
-        Serial.printf("NET_PER_PUK_REQUIRED\n");
-        break;
-    case NET_SUB_PER_PIN_REQ:
-        Serial.printf("NET_SUB_PER_PIN_REQ\n");
-        break;
-    case NET_SUB_PER_PUK_REQ:
-        Serial.printf("NET_SUB_PER_PUK_REQ\n");
-        break;
-    case SERVICE_PROV_PER_PIN_REQ:
-        Serial.printf("SERVICE_PROV_PER_PIN_REQ\n");
-        break;
-    case SERVICE_PROV_PER_PUK_REQ:
-        Serial.printf("SERVICE_PROV_PER_PUK_REQ\n");
-        break;
-    case CORPORATE_PER_PIN_REQ:
-        Serial.printf("CORPORATE_PER_PIN_REQ\n");
-        break;
-    case CORPORATE_PER_PUK_REQ:
-        Serial.printf("CORPORATE_PER_PUK_REQ\n");
-        break;
-    case PHSIM_PBK_REQUIRED:
-        Serial.printf("PHSIM_PBK_REQUIRED\n");
-        break;
-    case EXE_NOT_SURPORT:
-        Serial.printf("EXE_NOT_SURPORT\n");
-        break;
-    case EXE_FAIL:
-        Serial.printf("EXE_FAIL\n");
-        break;
-    case NO_MEMORY:
-        Serial.printf("NO_MEMORY\n");
-        break;
-    case OPTION_NOT_SURPORT:
-        Serial.printf("OPTION_NOT_SURPORT\n");
-        break;
-    case PARAM_INVALID:
-        Serial.printf("PARAM_INVALID\n");
-        break;
-    case EXT_REG_NOT_EXIT:
-        Serial.printf("EXT_REG_NOT_EXIT\n");
-        break;
-    case EXT_SMS_NOT_EXIT:
-        Serial.printf("EXT_SMS_NOT_EXIT\n");
-        break;
-    case EXT_PBK_NOT_EXIT:
-        Serial.printf("EXT_PBK_NOT_EXIT\n");
-        break;
-    case EXT_FFS_NOT_EXIT:
-        Serial.printf("EXT_FFS_NOT_EXIT\n");
-        break;
-    case INVALID_COMMAND_LINE:
-        Serial.printf("INVALID_COMMAND_LINE\n");
-        break;
-    case GPRS_ILLEGAL_MS_3:
-        Serial.printf("GPRS_ILLEGAL_MS_3\n");
-        break;
-    case GPRS_ILLEGAL_MS_6:
-        Serial.printf("GPRS_ILLEGAL_MS_6\n");
-        break;
-    case GPRS_SVR_NOT_ALLOWED:
-        Serial.printf("GPRS_SVR_NOT_ALLOWED\n");
-        break;
-    case GPRS_PLMN_NOT_ALLOWED:
-        Serial.printf("GPRS_PLMN_NOT_ALLOWED\n");
-        break;
-    case GPRS_LOCATION_AREA_NOT_ALLOWED:
-        Serial.printf("GPRS_LOCATION_AREA_NOT_ALLOWED\n");
-        break;
-    case GPRS_ROAMING_NOT_ALLOWED:
-        Serial.printf("GPRS_ROAMING_NOT_ALLOWED\n");
-        break;
-    case GPRS_OPTION_NOT_SUPPORTED:
-        Serial.printf("GPRS_OPTION_NOT_SUPPORTED\n");
-        break;
-    case GPRS_OPTION_NOT_SUBSCRIBED:
-        Serial.printf("GPRS_OPTION_NOT_SUBSCRIBED\n");
-        break;
-    case GPRS_OPTION_TEMP_ORDER_OUT:
-        Serial.printf("GPRS_OPTION_TEMP_ORDER_OUT\n");
-        break;
-    case GPRS_PDP_AUTHENTICATION_FAILURE:
-        Serial.printf("GPRS_PDP_AUTHENTICATION_FAILURE\n");
-        break;
-    case GPRS_INVALID_MOBILE_CLASS:
-        Serial.printf("GPRS_INVALID_MOBILE_CLASS\n");
-        break;
-    case GPRS_UNSPECIFIED_GPRS_ERROR:
-        Serial.printf("GPRS_UNSPECIFIED_GPRS_ERROR\n");
-        break;
-    case SIM_VERIFY_FAIL:
-        Serial.printf("SIM_VERIFY_FAIL\n");
-        break;
-    case SIM_UNBLOCK_FAIL:
-        Serial.printf("SIM_UNBLOCK_FAIL\n");
-        break;
-    case SIM_CONDITION_NO_FULLFILLED:
-        Serial.printf("SIM_CONDITION_NO_FULLFILLED\n");
-        break;
-    case SIM_UNBLOCK_FAIL_NO_LEFT:
-        Serial.printf("SIM_UNBLOCK_FAIL_NO_LEFT\n");
-        break;
-    case SIM_VERIFY_FAIL_NO_LEFT:
-        Serial.printf("SIM_VERIFY_FAIL_NO_LEFT\n");
-        break;
-    case SIM_INVALID_PARAMETER:
-        Serial.printf("SIM_INVALID_PARAMETER\n");
-        break;
-    case SIM_UNKNOW_COMMAND:
-        Serial.printf("SIM_UNKNOW_COMMAND\n");
-        break;
-    case SIM_WRONG_CLASS:
-        Serial.printf("SIM_WRONG_CLASS\n");
-        break;
-    case SIM_TECHNICAL_PROBLEM:
-        Serial.printf("SIM_TECHNICAL_PROBLEM\n");
-        break;
-    case SIM_CHV_NEED_UNBLOCK:
-        Serial.printf("SIM_CHV_NEED_UNBLOCK\n");
-        break;
-    case SIM_NOEF_SELECTED:
-        Serial.printf("SIM_NOEF_SELECTED\n");
-        break;
-    case SIM_FILE_UNMATCH_COMMAND:
-        Serial.printf("SIM_FILE_UNMATCH_COMMAND\n");
-        break;
-    case SIM_CONTRADICTION_CHV:
-        Serial.printf("SIM_CONTRADICTION_CHV\n");
-        break;
-    case SIM_CONTRADICTION_INVALIDATION:
-        Serial.printf("SIM_CONTRADICTION_INVALIDATION\n");
-        break;
-    case SIM_MAXVALUE_REACHED:
-        Serial.printf("SIM_MAXVALUE_REACHED\n");
-        break;
-    case SIM_PATTERN_NOT_FOUND:
-        Serial.printf("SIM_PATTERN_NOT_FOUND\n");
-        break;
-    case SIM_FILEID_NOT_FOUND:
-        Serial.printf("SIM_FILEID_NOT_FOUND\n");
-        break;
-    case SIM_STK_BUSY:
-        Serial.printf("SIM_STK_BUSY\n");
-        break;
-    case SIM_UNKNOW:
-        Serial.printf("SIM_UNKNOW\n");
-        break;
-    case SIM_PROFILE_ERROR:
-        Serial.printf("SIM_PROFILE_ERROR\n");
-        break;
-    default:
-        break;
+        return 0;
+    }
+    GetMetrics(m);
+
+    size_t len = 0;
+    len = _putVarint(buffer, size, len, METRICS_FORMAT_VERSION);
+    len = _putVarint(buffer, size, len, m->bytes_read);
+    len = _putVarint(buffer, size, len, m->bytes_written);
+    len = _putVarint(buffer, size, len, m->unknown_terms);
+    len = _putVarint(buffer, size, len, m->overflows);
+    len = _putVarint(buffer, size, len, m->rx_overruns);
+    len = _putVarint(buffer, size, len, m->commands);
+    len = _putVarint(buffer, size, len, m->command_errors);
+    len = _putVarint(buffer, size, len, m->command_timeouts);
+    len = _putVarint(buffer, size, len, m->blocked_ms);
+    len = _putVarint(buffer, size, len, TERM_MAX);
+    for (uint8_t i = 0; i < TERM_MAX; i++)
+    {
+        len = _putVarint(buffer, size, len, m->terms[i]);
+    }
+#ifndef A9G_NO_LATENCY
+    len = _putVarint(buffer, size, len, CMD_MAX);
+    len = _putVarint(buffer, size, len, LATENCY_BUCKETS);
+    for (uint8_t i = 0; i < CMD_MAX; i++)
+    {
+        for (uint8_t j = 0; j < LATENCY_BUCKETS; j++)
+        {
+            len = _putVarint(buffer, size, len, m->latency[i][j]);
+        }
+    }
+#else
+    len = _putVarint(buffer, size, len, 0);
+    len = _putVarint(buffer, size, len, 0);
+#endif
+    free(m);
+    return len <= size ? len : 0;
+}
+
+void GSM::ResetMetrics()
+{
+    memset(&_metrics, 0, sizeof(_metrics));
+    _tap.bytesRead = 0;
+    _tap.bytesWritten = 0;
+    _rx.overflows = 0;
+    _overrunsBase = _tap.overruns();
+}
+
+void GSM::SetTrace(A9G_Trace *trace)
+{
+    _tap.trace = trace;
+}
+
+void GSM::SetCompression(bool enable)
+{
+    _compress = enable;
+}
+
+AT_Result_t GSM::GetLastResult()
+{
+    return _lastResult;
+}
+
+bool GSM::bIsReady()
+{
+    _smsWaitIdle();
+    _gsm->println("AT");
+    if (_checkResponse(CMD_AT))
+    {
+        if (_debug)
+        {
+            Serial.println(F("GSM Ready"));
+        }
+        return true;
+    }
+    else
+        return false;
+}
+
+
+bool GSM::waitForReady()
+{
+    BeginReadyWait(READY_TIMEOUT_MS);
+    while (_readyState == READY_BOOTING)
+    {
+        executeCallback();
+    }
+    return _readyState == READY_OK;
+}
+
+void GSM::BeginReadyWait(unsigned long timeout_ms)
+{
+    _readyTimeoutMS = timeout_ms;
+    _readyCycles = 0;
+    _readyStartMS = millis();
+    _readyPollMS = _readyStartMS;
+    _readySet(READY_BOOTING);
+    _gsm->println("AT");
+}
+
+Ready_State_t GSM::GetReadyState()
+{
+    return _readyState;
+}
+
+void GSM::SetPowerCycle(PowerCycleCallback powerCycle)
+{
+    _powerCycle = powerCycle;
+}
+
+void GSM::_readySet(Ready_State_t state)
+{
+    _readyState = state;
+    if (_debug)
+    {
+        Serial.print(F("GSM ready state: "));
+        Serial.println(state);
+    }
+    if (!_eventCallback)
+    {
+        return;
+    }
+
+    A9G_Event_t *event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+    if (!event)
+    {
+        return;
+    }
+    _clearEvent(event, EVENT_READY);
+    event->param1 = state;
+    _eventCallback(event);
+    free(event);
+}
+
+void GSM::_readyOnLine(const char line[])
+{
+    if (!strncmp(line, READY_BANNER, strlen(READY_BANNER)))
+    {
+        // The module (re)started: whatever was cached about the bearer is gone, and so are replies
+        // to anything sent before.
+        _stateReset(_state);
+        _asyncCancel();
+        if (_readyState != READY_BOOTING)
+        {
+            _readyCycles = 0;
+            _readyStartMS = millis();
+            _readyPollMS = _readyStartMS;
+            _readySet(READY_BOOTING);
+        }
+    }
+    else if (!strcmp(line, "READY"))
+    {
+        _stateReset(_state);
+        _asyncCancel();
+        _readySet(READY_OK);
+    }
+    else if (strstr(line, "NO SIM CARD"))
+    {
+        _readySet(READY_NO_SIM);
+    }
+}
+
+void GSM::_readyOnTerm(uint8_t term_id, const char data[])
+{
+    if (term_id == TERM_CPIN && _readyState == READY_BOOTING && strstr(data, "READY"))
+    {
+        _readySet(READY_OK);
+    }
+}
+
+void GSM::_readyPoll()
+{
+    if (_readyState != READY_BOOTING)
+    {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (now - _readyStartMS >= _readyTimeoutMS)
+    {
+        _readySet(READY_TIMEOUT);
+        if (!_powerCycle || _readyCycles >= READY_MAX_POWER_CYCLES)
+        {
+            return;
+        }
+        _readyCycles++;
+        _powerCycle();
+        // Whatever arrived while the module was switched off is noise.
+        _rx.clear();
+        _asyncCancel();
+        _readyStartMS = millis();
+        _readyPollMS = _readyStartMS;
+        _readySet(READY_BOOTING);
+        _gsm->println("AT");
+    }
+    else if (now - _readyPollMS >= READY_POLL_MS && !_asyncWaiting())
+    {
+        // An unanswered poll is left to expire first; stacking them up would make the module's
+        // first OKs after READY look like their replies.
+        _readyPollMS = now;
+        _gsm->println(F("AT+CPIN?"));
+        _asyncSent();
+    }
+}
+
+AT_Result_t GSM::SetSleepMode(bool enable)
+{
+    _smsWaitIdle();
+    _gsm->print(F("AT+SLEEP="));
+    _gsm->println(enable ? 1 : 0);
+    AT_Result_t result = _checkResponse(CMD_SLEEP);
+    if (result)
+    {
+        _tap.setWake(enable ? SLEEP_WAKE_IDLE_MS : 0, SLEEP_WAKE_DELAY_MS);
+    }
+    return result;
+}
+
+AT_Result_t GSM::SetFlowControl(bool enable)
+{
+    _smsWaitIdle();
+    _gsm->println(enable ? F("AT+IFC=2,2") : F("AT+IFC=0,0"));
+    AT_Result_t result = _checkResponse(CMD_IFC);
+    if (result)
+    {
+        _tap.setFlowControl(enable);
+    }
+    return result;
+}
+
+bool GSM::bIsIdle()
+{
+    _rx.fill(_gsm);
+    if (_rx.pending() || _asyncWaiting())
+    {
+        return false;
+    }
+#ifndef A9G_NO_EVENT_LANES
+    for (uint8_t i = 0; i < EVENT_PRIORITY_MAX; i++)
+    {
+        if (_lanes[i].count())
+        {
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < COALESCE_SLOTS; i++)
+    {
+        if (_coalesce[i].pending)
+        {
+            return false;
+        }
+    }
+#endif
+#ifndef A9G_NO_SMS
+    if (_smsState == SMS_SEND_WAIT_PROMPT || _smsState == SMS_SEND_WAIT_REF || GetOutboxCount() || _smsReadCount)
+    {
+        return false;
+    }
+#endif
+    return true;
+}
+
+void GSM::ResumeAfterSleep()
+{
+    _resumed = true;
+    _rx.fill(_gsm);
+}
+
+// AT+CSQ: Check signal strength (in dBm).
+// AT+CCID: Read the ICCID (Integrated Circuit Card Identifier) of the SIM card.
+
+void GSM::ReadIMEI(){
+    _smsWaitIdle();
+    _gsm->println("AT+EGMR=2,7");
+    _checkResponse(CMD_EGMR);
+}
+/**
+ * @brief 
+ * @todo need to implement: issue.
+ * 
+ */
+void GSM::ReadCSQ(){
+    _smsWaitIdle();
+    _gsm->println("AT+CSQ");
+    _checkResponse(CMD_CSQ);
+}
+void GSM::ReadCCID(){
+    _smsWaitIdle();
+    _gsm->println("AT+CCID");
+    _checkResponse(CMD_CCID);
+}
+
+AT_Result_t GSM::BeginSignalMonitor(unsigned long interval_ms)
+{
+    _smsWaitIdle();
+    _signalIntervalMS = interval_ms;
+    _signalLastMS = millis();
+    _gsm->println(F("AT+CREG=2"));
+    return _checkResponse(CMD_CREG);
+}
+
+bool GSM::GetSignal(Signal_Sample_t *sample)
+{
+    *sample = _signalNow;
+    return _signalSeen;
+}
+
+uint8_t GSM::GetSignalHistory(Signal_Sample_t samples[], uint8_t max)
+{
+#if SIGNAL_HISTORY_SIZE > 0
+    uint8_t n = _signalCount < max ? _signalCount : max;
+    // The newest n samples, oldest first.
+    uint8_t start = (_signalHead + SIGNAL_HISTORY_SIZE - n) % SIGNAL_HISTORY_SIZE;
+    for (uint8_t i = 0; i < n; i++)
+    {
+        samples[i] = _signalHistory[(start + i) % SIGNAL_HISTORY_SIZE];
+    }
+    return n;
+#else
+    (void)samples;
+    (void)max;
+    return 0;
+#endif
+}
+
+void GSM::_signalOnTerm(uint8_t term_id, const char data[])
+{
+    if (term_id == TERM_CSQ)
+    {
+        // <rssi>,<ber>
+        const char *comma = strchr(data, ',');
+        _signalNow.time_ms = millis();
+        _signalNow.rssi = atoi(data);
+        _signalNow.ber = comma ? atoi(comma + 1) : 99;
+        _signalNow.creg = _state->creg;
+        _signalSeen = true;
+#if SIGNAL_HISTORY_SIZE > 0
+        _signalHistory[_signalHead] = _signalNow;
+        _signalHead = (_signalHead + 1) % SIGNAL_HISTORY_SIZE;
+        if (_signalCount < SIGNAL_HISTORY_SIZE)
+        {
+            _signalCount++;
+        }
+#endif
+    }
+    else if (term_id == TERM_CREG)
+    {
+        // With AT+CREG=2: [<n>,]<stat>,"<lac>","<ci>", location left out while not registered.
+        _signalNow.creg = _state->creg;
+        _signalNow.lac = 0;
+        _signalNow.ci = 0;
+        const char *quote = strchr(data, '"');
+        if (quote)
+        {
+            _signalNow.lac = strtoul(quote + 1, NULL, 16);
+            quote = strchr(quote + 1, '"');
+            quote = quote ? strchr(quote + 1, '"') : NULL;
+            if (quote)
+            {
+                _signalNow.ci = strtoul(quote + 1, NULL, 16);
+            }
+        }
+    }
+}
+
+void GSM::_signalPoll()
+{
+    unsigned long now = millis();
+    if (!_signalIntervalMS || now - _signalLastMS < _signalIntervalMS || now - _lastCommandMS < SIGNAL_IDLE_GAP_MS)
+    {
+        return;
+    }
+    if (_readyState == READY_BOOTING || !bIsIdle())
+    {
+        return;
+    }
+    _signalLastMS = now;
+    _gsm->println(F("AT+CSQ"));
+    _asyncSent();
+}
+
+void GSM::_asyncSent(unsigned long timeout_ms)
+{
+    // Callers check _asyncWaiting() (or bIsIdle()) first, so only one request is outstanding and
+    // the expiry below is its own.
+    _asyncPending = true;
+    _asyncSentMS = millis();
+    _asyncTimeoutMS = timeout_ms;
+    _lastCommandMS = _asyncSentMS;
+}
+
+void GSM::_asyncCancel()
+{
+    _asyncPending = false;
+#ifndef A9G_NO_MQTT
+    if (_publishWaiting)
+    {
+        _publishEnd(AT_TIMEOUT, 0);
+    }
+#endif
+}
+
+bool GSM::_asyncWaiting()
+{
+    if (_asyncPending && millis() - _asyncSentMS > _asyncTimeoutMS)
+    {
+        _asyncCancel();
+    }
+    return _asyncPending;
+}
+
+bool GSM::_asyncOnFinal(AT_Status_t status, int error)
+{
+    if (!_asyncWaiting())
+    {
+        return false;
+    }
+    _asyncPending = false;
+#ifndef A9G_NO_MQTT
+    if (_publishWaiting)
+    {
+        _publishEnd(status, error);
+    }
+#else
+    (void)status;
+    (void)error;
+#endif
+    return true;
+}
+
+AT_Result_t GSM::IsGPRSAttached()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+CGATT?");
+    return _checkResponse(CMD_CGATT_READ);
+}
+
+AT_Result_t GSM::AttachToGPRS()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+CGATT=1");
+    AT_Result_t result = _checkResponse(CMD_CGATT);
+    if (result)
+    {
+        _state->attached = 1;
+        _stateSave();
+    }
+    return result;
+}
+
+AT_Result_t GSM::DetachToGPRS()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+CGATT=0");
+    AT_Result_t result = _checkResponse(CMD_CGATT);
+    if (result)
+    {
+        _state->attached = 0;
+        _state->pdp_active = 0;
+        _stateSave();
+    }
+    return result;
+}
+
+AT_Result_t GSM::SetAPN(const char pdp_type[], const char apn[])
+{
+    _smsWaitIdle();
+    _gsm->print("AT+CGDCONT=1,\"");
+    _gsm->print(pdp_type);
+    _gsm->print("\",\"");
+    _gsm->print(apn);
+    _gsm->println("\"");
+
+    AT_Result_t result = _checkResponse(CMD_CGDCONT);
+    if (result)
+    {
+        strncpy(_state->pdp_type, pdp_type, sizeof(_state->pdp_type) - 1);
+        _state->pdp_type[sizeof(_state->pdp_type) - 1] = '\0';
+        strncpy(_state->apn, apn, sizeof(_state->apn) - 1);
+        _state->apn[sizeof(_state->apn) - 1] = '\0';
+        _stateSave();
+    }
+    return result;
+}
+
+AT_Result_t GSM::ActivatePDP()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+CGACT=1,1");
+    AT_Result_t result = _checkResponse(CMD_CGACT);
+    if (result)
+    {
+        _state->pdp_active = 1;
+        _stateSave();
+    }
+    return result;
+}
+
+AT_Result_t GSM::DeactivatePDP()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+CGACT=0,1");
+    AT_Result_t result = _checkResponse(CMD_CGACT);
+    if (result)
+    {
+        _state->pdp_active = 0;
+        _stateSave();
+    }
+    return result;
+}
+
+static uint8_t _stateChecksum(const A9G_State_t *state)
+{
+    const uint8_t *p = (const uint8_t *)state;
+    uint8_t sum = 0;
+    for (size_t i = 0; i < offsetof(A9G_State_t, checksum); i++)
+    {
+        sum = (sum << 1 | sum >> 7) ^ p[i];
+    }
+    return sum;
+}
+
+void GSM::_stateReset(A9G_State_t *state)
+{
+    memset(state, 0, sizeof(A9G_State_t));
+    state->magic = A9G_STATE_MAGIC;
+    state->creg = -1;
+    state->attached = -1;
+    state->pdp_active = -1;
+    state->checksum = _stateChecksum(state);
+}
+
+void GSM::_stateSave()
+{
+    _state->checksum = _stateChecksum(_state);
+}
+
+void GSM::_stateOnTerm(uint8_t term_id, const char data[])
+{
+    if (term_id == TERM_CREG)
+    {
+        // Read response: <n>,<stat>[,<lac>,<ci>]  URC: <stat>[,<lac>,<ci>]
+        const char *next = strchr(data, ',');
+        if (next)
+        {
+            next++;
+            while (*next == ' ')
+            {
+                next++;
+            }
+        }
+        _state->creg = atoi(next && *next != '"' ? next : data);
+    }
+    else if (term_id == TERM_CGATT)
+    {
+        _state->attached = atoi(data) == 1;
+    }
+    else if (term_id == TERM_CGACT)
+    {
+        // <cid>,<state>
+        const char *comma = strchr(data, ',');
+        if (!comma || atoi(data) != 1)
+        {
+            return;
+        }
+        _state->pdp_active = atoi(comma + 1) == 1;
+    }
+    else if (term_id == TERM_CGDCONT)
+    {
+        // <cid>,"<type>","<apn>",...
+        if (atoi(data) != 1)
+        {
+            return;
+        }
+        char *fields[2] = {_state->pdp_type, _state->apn};
+        const size_t sizes[2] = {sizeof(_state->pdp_type), sizeof(_state->apn)};
+        const char *p = strchr(data, '"');
+        for (uint8_t i = 0; i < 2 && p; i++)
+        {
+            const char *end = strchr(p + 1, '"');
+            if (!end)
+            {
+                break;
+            }
+            size_t len = end - p - 1;
+            if (len > sizes[i] - 1)
+            {
+                len = sizes[i] - 1;
+            }
+            memcpy(fields[i], p + 1, len);
+            fields[i][len] = '\0';
+            p = strchr(end + 1, '"');
+        }
+    }
+    else
+    {
+        return;
+    }
+    _stateSave();
+}
+
+void GSM::SetStateStore(A9G_State_t *store)
+{
+    if (store->magic != A9G_STATE_MAGIC || store->checksum != _stateChecksum(store))
+    {
+        _stateReset(store);
+    }
+    _state = store;
+}
+
+void GSM::GetState(A9G_State_t *state)
+{
+    *state = *_state;
+}
+
+AT_Result_t GSM::QueryState()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+CREG?");
+    AT_Result_t result = _checkResponse(CMD_CREG_READ);
+    if (!result)
+    {
+        return result;
+    }
+
+    _gsm->println("AT+CGATT?");
+    result = _checkResponse(CMD_CGATT_READ);
+    if (!result)
+    {
+        return result;
+    }
+
+    // Contexts that are not defined or not active are simply not listed.
+    _state->pdp_type[0] = '\0';
+    _state->apn[0] = '\0';
+    _gsm->println("AT+CGDCONT?");
+    result = _checkResponse(CMD_CGDCONT_READ);
+    if (!result)
+    {
+        return result;
+    }
+
+    _state->pdp_active = 0;
+    _gsm->println("AT+CGACT?");
+    result = _checkResponse(CMD_CGACT_READ);
+    _stateSave();
+    return result;
+}
+
+AT_Result_t GSM::WarmStart(const char pdp_type[], const char apn[])
+{
+    _smsWaitIdle();
+    AT_Result_t result;
+    bool same_apn = !strcmp(_state->pdp_type, pdp_type) && !strcmp(_state->apn, apn);
+
+    if (_state->attached == 1 && _state->pdp_active == 1 && same_apn)
+    {
+        _state->pdp_active = 0;
+        _gsm->println("AT+CGACT?");
+        result = _checkResponse(CMD_CGACT_READ);
+        _stateSave();
+        if (result && _state->pdp_active == 1)
+        {
+            return result;
+        }
+    }
+
+    result = QueryState();
+    if (!result)
+    {
+        return result;
+    }
+    same_apn = !strcmp(_state->pdp_type, pdp_type) && !strcmp(_state->apn, apn);
+
+    if (_state->attached != 1)
+    {
+        result = AttachToGPRS();
+        if (!result)
+        {
+            return result;
+        }
+    }
+    if (!same_apn)
+    {
+        // The context cannot be redefined while it is active.
+        if (_state->pdp_active == 1 && !(result = DeactivatePDP()))
+        {
+            return result;
+        }
+        result = SetAPN(pdp_type, apn);
+        if (!result)
+        {
+            return result;
+        }
+    }
+    if (_state->pdp_active != 1)
+    {
+        result = ActivatePDP();
+    }
+    return result;
+}
+
+
+#if !defined(A9G_NO_MQTT) || !defined(A9G_NO_SMS)
+static void _writeEncoded(Print *out, const uint8_t data[], size_t len, Payload_Encoding_t encoding)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char chunk[64];
+    size_t n = 0;
+
+    if (encoding == PAYLOAD_HEX)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            chunk[n++] = hex[data[i] >> 4];
+            chunk[n++] = hex[data[i] & 0x0F];
+            if (n == sizeof(chunk))
+            {
+                out->write((const uint8_t *)chunk, n);
+                n = 0;
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < len; i += 3)
+        {
+            uint32_t v = (uint32_t)data[i] << 16;
+            if (i + 1 < len)
+            {
+                v |= data[i + 1] << 8;
+            }
+            if (i + 2 < len)
+            {
+                v |= data[i + 2];
+            }
+            chunk[n++] = base64[v >> 18];
+            chunk[n++] = base64[(v >> 12) & 0x3F];
+            chunk[n++] = i + 1 < len ? base64[(v >> 6) & 0x3F] : '=';
+            chunk[n++] = i + 2 < len ? base64[v & 0x3F] : '=';
+            if (n == sizeof(chunk))
+            {
+                out->write((const uint8_t *)chunk, n);
+                n = 0;
+            }
+        }
+    }
+    out->write((const uint8_t *)chunk, n);
+}
+
+// Print into a fixed, null terminated buffer.
+class _TextBuffer : public Print
+{
+private:
+    char *_text;
+    size_t _size;
+    size_t _len = 0;
+
+public:
+    _TextBuffer(char text[], size_t size) : _text(text), _size(size)
+    {
+        _text[0] = '\0';
+    }
+
+    size_t write(uint8_t c)
+    {
+        if (_len + 1 >= _size)
+        {
+            return 0;
+        }
+        _text[_len++] = c;
+        _text[_len] = '\0';
+        return 1;
+    }
+    using Print::write;
+};
+
+// Compresses text into a frame if the frame, base64 encoded, is shorter than the text.
+// Returns the frame (free() it) or NULL.
+static uint8_t *_compressText(const char text[], size_t *frame_len)
+{
+    size_t len = strlen(text);
+    uint8_t *frame = (uint8_t *)malloc(compressBound(len));
+    if (!frame)
+    {
+        return NULL;
+    }
+    *frame_len = compressFrame((const uint8_t *)text, len, frame, compressBound(len));
+    if (!*frame_len || (*frame_len + 2) / 3 * 4 >= len)
+    {
+        free(frame);
+        return NULL;
+    }
+    return frame;
+}
+#endif
+
+#ifndef A9G_NO_MQTT
+AT_Result_t GSM::ConnectToBroker(const char broker[], int port, const char user[], const char pass[], const char id[], uint8_t keep_alive, uint16_t clean_session)
+{
+    _smsWaitIdle();
+    _gsm->print("AT+MQTTCONN=\"");
+    _gsm->print(broker);
+    _gsm->print("\",");
+    _gsm->print(port);
+    _gsm->print(",\"");
+    _gsm->print(id);
+    _gsm->print("\",");
+    _gsm->print(keep_alive);
+    _gsm->print(",");
+    _gsm->print(clean_session);
+    _gsm->print(",\"");
+    _gsm->print(user);
+    _gsm->print("\",\"");
+    _gsm->print(pass);
+    _gsm->println("\"");
+
+    return _checkResponse(CMD_MQTTCONN);
+}
+
+AT_Result_t GSM::ConnectToBroker(const char broker[], int port, const char id[], uint8_t keep_alive, uint16_t clean_session)
+{
+    _smsWaitIdle();
+    _gsm->print("AT+MQTTCONN=\"");
+    _gsm->print(broker);
+    _gsm->print("\",");
+    _gsm->print(port);
+    _gsm->print(",\"");
+    _gsm->print(id);
+    _gsm->print("\",");
+    _gsm->print(keep_alive);
+    _gsm->print(",");
+    _gsm->println(clean_session);
+
+    return _checkResponse(CMD_MQTTCONN);
+}
+
+AT_Result_t GSM::ConnectToBroker(const char broker[], int port)
+{
+    _smsWaitIdle();
+    char id[10] = "\0";
+    sprintf(id, "%d", random(10000, 100000));
+    _gsm->print("AT+MQTTCONN=\"");
+    _gsm->print(broker);
+    _gsm->print("\",");
+    _gsm->print(port);
+    _gsm->print(",\"");
+    _gsm->print(id);
+    _gsm->print("\",");
+    _gsm->print(120);
+    _gsm->print(",");
+    _gsm->println(0);
+
+    return _checkResponse(CMD_MQTTCONN);
+}
+
+AT_Result_t GSM::DisconnectBroker()
+{
+    _smsWaitIdle();
+    _gsm->println("AT+MQTTDISCONN");
+    return _checkResponse(CMD_MQTTDISCONN);
+}
+AT_Result_t GSM::SubscribeToTopic(const char topic[], uint8_t qos, unsigned long timeout)
+{
+    _smsWaitIdle();
+    _gsm->print("AT+MQTTSUB=\"");
+    _gsm->print(topic);
+    _gsm->print("\",");
+    _gsm->print(qos);
+    _gsm->print(",");
+    _gsm->println(timeout);
+
+    AT_Result_t result = _checkResponse(CMD_MQTTSUB);
+    if (result)
+    {
+        Serial.print(F("Subscribe To Topic:\""));
+        Serial.print(topic);
+        Serial.println(F("\"  success"));
+    }
+    return result;
+}
+AT_Result_t GSM::SubscribeToTopic(const char topic[])
+{
+    _smsWaitIdle();
+    _gsm->print("AT+MQTTSUB=\"");
+    _gsm->print(topic);
+    _gsm->print("\",");
+    _gsm->print(1);
+    _gsm->print(",");
+    _gsm->println(0);
+
+    AT_Result_t result = _checkResponse(CMD_MQTTSUB);
+    if (result)
+    {
+        Serial.print(F("Subscribe To Topic:\""));
+        Serial.print(topic);
+        Serial.println(F("\"  success"));
+    }
+    return result;
+}
+
+AT_Result_t GSM::UnsubscribeToTopic(const char topic[])
+{
+    _smsWaitIdle();
+    _gsm->print("AT+MQTTUNSUB=\"");
+    _gsm->print(topic);
+    _gsm->println("\"");
+    AT_Result_t result = _checkResponse(CMD_MQTTUNSUB);
+    if (result)
+    {
+        Serial.print(F("Unsubscribe To Topic:\""));
+        Serial.print(topic);
+        Serial.println(F("\"  success"));
+    }
+    return result;
+}
+
+
+AT_Result_t GSM::PublishToTopic(const char topic[], const char msg[])
+{
+    _smsWaitIdle();
+    size_t frame_len;
+    uint8_t *frame = _compress ? _compressText(msg, &frame_len) : NULL;
+    if (frame)
+    {
+        AT_Result_t result = PublishBinary(topic, frame, frame_len);
+        free(frame);
+        return result;
+    }
+
+    _gsm->print("AT+MQTTPUB=\"");
+    _gsm->print(topic);
+    _gsm->print("\",\"");
+    _gsm->print(msg);
+    _gsm->println("\",2,0,0");
+
+    return _checkResponse(CMD_MQTTPUB);
+}
+
+AT_Result_t GSM::PublishBinary(const char topic[], const uint8_t data[], size_t len, Payload_Encoding_t encoding)
+{
+    _smsWaitIdle();
+    _gsm->print("AT+MQTTPUB=\"");
+    _gsm->print(topic);
+    _gsm->print("\",\"");
+    _writeEncoded(_gsm, data, len, encoding);
+    _gsm->println("\",2,0,0");
+
+    return _checkResponse(CMD_MQTTPUB);
+}
+
+int GSM::QueuePublish(const char topic[], const char msg[], bool urgent, unsigned long max_delay_ms)
+{
+    if (strlen(topic) >= MQTT_QUEUE_TOPIC_SIZE || strlen(msg) >= MQTT_QUEUE_PAYLOAD_SIZE)
+    {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < MQTT_QUEUE_SIZE; i++)
+    {
+        MQTT_Queue_Entry_t *entry = &_publishQueue[i];
+        if (entry->used)
+        {
+            continue;
+        }
+        entry->used = true;
+        entry->id = _publishNextId++;
+        entry->attempts = 0;
+        entry->dueMS = millis() + (urgent ? 0 : max_delay_ms);
+        strcpy(entry->topic, topic);
+        strcpy(entry->payload, msg);
+        if (urgent)
+        {
+            _publishFlushing = true;
+        }
+        return entry->id;
+    }
+    return -1;
+}
+
+bool GSM::BeginPublish(const char topic[], const uint8_t data[], size_t len, Payload_Encoding_t encoding)
+{
+    if (_publishWaiting || _readyState == READY_BOOTING || !bIsIdle())
+    {
+        return false;
+    }
+    _gsm->print("AT+MQTTPUB=\"");
+    _gsm->print(topic);
+    _gsm->print("\",\"");
+    _writeEncoded(_gsm, data, len, encoding);
+    _gsm->println("\",2,0,0");
+
+    _publishWaiting = true;
+    _publishDone = false;
+    _asyncSent(GetCommandTimeout(CMD_MQTTPUB));
+    return true;
+}
+
+bool GSM::PollPublish(AT_Result_t *result)
+{
+    if (_publishWaiting)
+    {
+        executeCallback();
+        _asyncWaiting();
+    }
+    if (!_publishDone)
+    {
+        return false;
+    }
+    _publishDone = false;
+    *result = _publishResult;
+    return true;
+}
+
+void GSM::_publishEnd(AT_Status_t status, int error)
+{
+    _publishResult.status = status;
+    _publishResult.error = error;
+    _publishResult.latency_ms = millis() - _asyncSentMS;
+    if (status == AT_TIMEOUT)
+    {
+        _recordTimeout(CMD_MQTTPUB, _publishResult.latency_ms);
+    }
+    else
+    {
+        _latency.record(CMD_MQTTPUB, _publishResult.latency_ms);
+    }
+    _countResult(_publishResult);
+    _lastResult = _publishResult;
+    _publishWaiting = false;
+    _publishDone = true;
+}
+
+void GSM::SetMqttDedupWindow(unsigned long window_ms)
+{
+    _dedupWindowMS = window_ms;
+}
+
+uint32_t GSM::GetMqttDuplicates()
+{
+    return _duplicates;
+}
+
+bool GSM::_mqttDuplicate(const char data[], int data_len)
+{
+    // <id>,<topic>,<length>,<payload>: a redelivery repeats the packet id, a new publish does not.
+    if (!_dedupWindowMS || !atoi(data))
+    {
+        return false;
+    }
+    uint32_t hash = _hash(data, data_len);
+    for (uint8_t i = 0; i < MQTT_DEDUP_SIZE; i++)
+    {
+        if (_dedup[i].time_ms && _dedup[i].hash == hash && millis() - _dedup[i].time_ms < _dedupWindowMS)
+        {
+            _duplicates++;
+            return true;
+        }
+    }
+    _dedup[_dedupHead].hash = hash;
+    _dedup[_dedupHead].time_ms = millis() | 1; // 0 marks an unused entry
+    _dedupHead = (_dedupHead + 1) % MQTT_DEDUP_SIZE;
+    return false;
+}
+
+void GSM::SetPublishThreshold(uint8_t rssi)
+{
+    _publishMinRSSI = rssi;
+}
+
+uint8_t GSM::GetPublishQueueCount()
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MQTT_QUEUE_SIZE; i++)
+    {
+        count += _publishQueue[i].used;
+    }
+    return count;
+}
+
+void GSM::FlushPublishQueue()
+{
+    _publishFlushing = true;
+}
+
+void GSM::_publishPoll()
+{
+    int8_t next = -1;
+    for (uint8_t i = 0; i < MQTT_QUEUE_SIZE; i++)
+    {
+        if (_publishQueue[i].used && (next < 0 || (long)(_publishQueue[i].dueMS - _publishQueue[next].dueMS) < 0))
+        {
+            next = i;
+        }
+    }
+    if (next < 0)
+    {
+        _publishFlushing = false;
+        return;
+    }
+
+    MQTT_Queue_Entry_t *entry = &_publishQueue[next];
+    unsigned long now = millis();
+    bool signal_ok = _signalNow.rssi != 99 && _signalNow.rssi >= _publishMinRSSI;
+    bool due = (long)(now - entry->dueMS) >= 0;
+    if (_publishHold)
+    {
+        if ((long)(now - _publishHoldMS) < 0)
+        {
+            return;
+        }
+        _publishHold = false;
+    }
+    if (!_publishFlushing && !signal_ok && !due)
+    {
+        return;
+    }
+    if (_readyState == READY_BOOTING || !bIsIdle())
+    {
+        return;
+    }
+
+    _publishFlushing = true;
+    entry->attempts++;
+    AT_Result_t result = PublishToTopic(entry->topic, entry->payload);
+    if (result || entry->attempts >= MQTT_QUEUE_RETRIES)
+    {
+        _publishFinish(next, result.status);
+        return;
+    }
+    _publishFlushing = false;
+    _publishHold = true;
+    _publishHoldMS = millis() + MQTT_QUEUE_RETRY_DELAY_MS;
+}
+
+void GSM::_publishFinish(uint8_t slot, int error)
+{
+    uint16_t id = _publishQueue[slot].id;
+    _publishQueue[slot].used = false;
+    if (!_eventCallback)
+    {
+        return;
+    }
+
+    A9G_Event_t *event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+    if (!event)
+    {
+        return;
+    }
+    _clearEvent(event, EVENT_MQTT_SENT);
+    event->param1 = id;
+    event->error = error;
+    _eventCallback(event);
+    free(event);
+}
+#endif
+
+#ifndef A9G_NO_HTTP
+AT_Result_t GSM::HTTPGet(const char url[], Print *body, HTTP_Response_t *response)
+{
+    _smsWaitIdle();
+    _gsm->print(F("AT+HTTPGET=\""));
+    _gsm->print(url);
+    _gsm->println("\"");
+    return _httpResponse(CMD_HTTPGET, body, response);
+}
+
+AT_Result_t GSM::HTTPPost(const char url[], const char content_type[], Stream *request, Print *body, HTTP_Response_t *response)
+{
+    _smsWaitIdle();
+    // The body is read in full and checked first: once part of the command is out it cannot be taken back.
+    char *buffer = (char *)malloc(HTTP_POST_MAX_SIZE + 1);
+    size_t len = 0;
+    size_t n;
+    bool quotable = buffer != NULL;
+    while (quotable && request && (n = request->readBytes(buffer + len, HTTP_POST_MAX_SIZE + 1 - len)) > 0)
+    {
+        len += n;
+        quotable = len <= HTTP_POST_MAX_SIZE;
+    }
+    for (size_t i = 0; quotable && i < len; i++)
+    {
+        quotable = buffer[i] != '"' && buffer[i] != '\r' && buffer[i] != '\n';
+    }
+    if (!quotable)
+    {
+        free(buffer);
+        AT_Result_t result = {AT_ERROR, 0, 0};
+        _lastResult = result;
+        return result;
+    }
+
+    _gsm->print(F("AT+HTTPPOST=\""));
+    _gsm->print(url);
+    _gsm->print("\",\"");
+    _gsm->print(content_type);
+    _gsm->print("\",\"");
+    _gsm->write((const uint8_t *)buffer, len);
+    _gsm->println("\"");
+    free(buffer);
+    return _httpResponse(CMD_HTTPPOST, body, response);
+}
+
+// Value of header <name> if line is that header, else NULL. line is not null terminated.
+static const char *_httpHeader(const char line[], size_t len, const char name[])
+{
+    size_t name_len = strlen(name);
+    if (len <= name_len || strncasecmp(line, name, name_len) || line[name_len] != ':')
+    {
+        return NULL;
+    }
+    const char *value = line + name_len + 1;
+    while (value < line + len && *value == ' ')
+    {
+        value++;
+    }
+    return value;
+}
+
+AT_Result_t GSM::_httpResponse(AT_Command_t cmd, Print *body, HTTP_Response_t *response)
+{
+    unsigned long start_time = millis();
+    unsigned long timeout = GetCommandTimeout(cmd);
+    AT_Result_t result = {AT_TIMEOUT, 0, 0};
+    HTTP_Response_t local;
+    char *line;
+    size_t len;
+
+    if (!response)
+    {
+        response = &local;
+    }
+    memset(response, 0, sizeof(HTTP_Response_t));
+    response->content_length = -1;
+
+    // Status line. The module's final result code may come before it or after the body.
+    A9G_Event_t *event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+    bool found = false;
+    while (!found && (result.status == AT_TIMEOUT || result.status == AT_OK) && (millis() - start_time) < timeout)
+    {
+        _rx.fill(_gsm);
+        while ((line = _rx.readLine(&len)) != nullptr)
+        {
+            if (!strncmp(line, "HTTP/", 5))
+            {
+                const char *code = strchr(line, ' ');
+                response->status = code ? atoi(code + 1) : 0;
+                found = true;
+                break;
+            }
+
+            int error = 0;
+            AT_Status_t status = _finalResultCode(line, &error);
+            if (status != AT_TIMEOUT)
+            {
+                if (!_asyncOnFinal(status, error))
+                {
+                    result.status = status;
+                    result.error = error;
+                    if (status != AT_OK)
+                    {
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            char *data;
+            int data_len;
+            uint8_t term_id = _termFromLine(line, &data, &data_len);
+            if (event && term_id != TERM_NONE && term_id != TERM_MAX)
+            {
+                _dispatchTerm(event, term_id, data, data_len);
+            }
+        }
+    }
+    free(event);
+    result.latency_ms = millis() - start_time;
+    if (found || (result.status != AT_TIMEOUT && result.status != AT_OK))
+    {
+        _latency.record(cmd, result.latency_ms);
+    }
+    else
+    {
+        // Nothing but perhaps an OK before the time ran out.
+        _recordTimeout(cmd, result.latency_ms);
+    }
+
+    if (found)
+    {
+        if (!_httpBody(body, response))
+        {
+            _httpDrain();
+        }
+
+        unsigned long wait = millis();
+        while (result.status == AT_TIMEOUT && millis() - wait < HTTP_FINAL_TIMEOUT_MS)
+        {
+            _rx.fill(_gsm);
+            while (result.status == AT_TIMEOUT && (line = _rx.readLine(&len)) != nullptr)
+            {
+                int error = 0;
+                AT_Status_t status = _finalResultCode(line, &error);
+                if (status != AT_TIMEOUT && !_asyncOnFinal(status, error))
+                {
+                    result.status = status;
+                    result.error = error;
+                }
+            }
+        }
+        if (result.status == AT_TIMEOUT)
+        {
+            // Some firmware ends the response without a final result code.
+            result.status = AT_OK;
+        }
+    }
+    else if (result.status == AT_OK)
+    {
+        // OK without a response.
+        result.status = AT_TIMEOUT;
+    }
+
+    _lastCommandMS = millis();
+    _countResult(result);
+    _lastResult = result;
+    return result;
+}
+
+bool GSM::_httpBody(Print *body, HTTP_Response_t *response)
+{
+    unsigned long last_rx = millis();
+    bool headers = true;
+    bool skip = false;          // rest of an overlong header line
+    bool crlf = false;          // CRLF after a chunk still to come
+    uint32_t chunk_left = 0;
+
+    while (millis() - last_rx < HTTP_IDLE_TIMEOUT_MS)
+    {
+        if (_rx.fill(_gsm))
+        {
+            last_rx = millis();
+        }
+        const char *p = _rx.peek();
+        size_t n = _rx.pending();
+        if (!n)
+        {
+            yield();
+            continue;
+        }
+
+        bool body_bytes = !headers && (!response->chunked || (chunk_left && !crlf));
+        if (!body_bytes)
+        {
+            // Header line, chunk size line or the CRLF closing a chunk.
+            const char *lf = (const char *)memchr(p, '\n', n);
+            if (!lf)
+            {
+                if (n >= RX_BUFFER_SIZE)
+                {
+                    _rx.consume(n);
+                    skip = true;
+                }
+                continue;
+            }
+            size_t line_len = lf - p;
+            if (line_len && p[line_len - 1] == '\r')
+            {
+                line_len--;
+            }
+
+            if (skip || crlf)
+            {
+                skip = false;
+                crlf = false;
+            }
+            else if (headers && !line_len)
+            {
+                headers = false;
+                if (response->content_length == 0)
+                {
+                    _rx.consume(lf - p + 1);
+                    response->complete = true;
+                    return true;
+                }
+            }
+            else if (headers)
+            {
+                const char *value;
+                if ((value = _httpHeader(p, line_len, "Content-Length")) != NULL)
+                {
+                    response->content_length = strtol(value, NULL, 10);
+                }
+                else if ((value = _httpHeader(p, line_len, "Transfer-Encoding")) != NULL)
+                {
+                    response->chunked = !strncasecmp(value, "chunked", 7);
+                }
+            }
+            else
+            {
+                chunk_left = strtoul(p, NULL, 16);
+                if (!chunk_left)
+                {
+                    // Last chunk. The closing empty line is skipped by the line parser.
+                    _rx.consume(lf - p + 1);
+                    response->complete = true;
+                    return true;
+                }
+            }
+            _rx.consume(lf - p + 1);
+            continue;
+        }
+
+        size_t take = n;
+        if (response->chunked && take > chunk_left)
+        {
+            take = chunk_left;
+        }
+        else if (!response->chunked && response->content_length >= 0 && take > (size_t)(response->content_length - response->body_len))
+        {
+            take = response->content_length - response->body_len;
+        }
+        if (body && body->write((const uint8_t *)p, take) != take)
+        {
+            return false;
+        }
+        _rx.consume(take);
+        response->body_len += take;
+
+        if (response->chunked)
+        {
+            chunk_left -= take;
+            crlf = !chunk_left;
+        }
+        else if (response->content_length >= 0 && response->body_len == (uint32_t)response->content_length)
+        {
+            response->complete = true;
+            return true;
+        }
+    }
+    // Idle: the end of a body without length, or a broken transfer.
+    return true;
+}
+
+void GSM::_httpDrain()
+{
+    unsigned long last_rx = millis();
+    while (millis() - last_rx < HTTP_DRAIN_QUIET_MS)
+    {
+        _rx.clear();
+        if (_rx.fill(_gsm))
+        {
+            last_rx = millis();
+        }
+        yield();
+    }
+    _rx.clear();
+}
+#endif
+
+
+
+
+
+
+void GSM::_smsWaitIdle()
+{
+#ifndef A9G_NO_SMS
+    // A command written now would land in the SMS body or take its +CMGS / +CMS ERROR.
+    while (_smsState == SMS_SEND_WAIT_PROMPT || _smsState == SMS_SEND_WAIT_REF)
+    {
+        executeCallback();
+    }
+#endif
+}
+
+#ifndef A9G_NO_SMS
+AT_Result_t GSM::ActivateTE()
+{
+    _smsWaitIdle();
+    _gsm->println(F("AT+CNMI=0,1,0,0,0"));
+    return _checkResponse(CMD_CNMI);
+}
+
+AT_Result_t GSM::SetFormatReading(bool mode)
+{
+    _smsWaitIdle();
+    _gsm->print(F("AT+CMGF="));
+    _gsm->println(mode);
+    AT_Result_t result = _checkResponse(CMD_CMGF);
+    if (result)
+    {
+        _pduMode = !mode;
+    }
+    return result;
+}
+
+AT_Result_t GSM::SetMessageStorageUnit()
+{
+    _smsWaitIdle();
+    _gsm->println(F("AT+CPMS=\"ME\",\"ME\",\"ME\""));
+    return _checkResponse(CMD_CPMS);
+}
+
+void GSM::CheckMessageStorageUnit(){
+    _gsm->println(F("AT+CPBS?"));
+}
+
+
+void GSM::ReadMessage(uint8_t index){
+    _smsWaitIdle();
+    _gsm->print("AT+CMGR=");
+    _gsm->println(index);
+}
+
+void GSM::DeleteMessage(uint8_t index,Message_Type_t type){
+    _smsWaitIdle();
+    _gsm->print(F("AT+CMGD="));
+    _gsm->print(index);
+    _gsm->print(F(","));
+    _gsm->println(type);
+}
+
+bool GSM::bSendMessage(const char number[], const char message[], int *reference)
+{
+    _smsWaitIdle();
+    _gsm->print(F("AT+CMGF="));
+    _gsm->println(_pduMode ? 0 : 1);
+    if (!_checkResponse(CMD_CMGF))
+    {
+        return false;
+    }
+
+    vSendMessage(number, message);
+    while (_smsState == SMS_SEND_WAIT_PROMPT || _smsState == SMS_SEND_WAIT_REF)
+    {
+        executeCallback();
+    }
+
+    if (_smsState != SMS_SEND_DONE)
+    {
+        return false;
+    }
+    if (reference)
+    {
+        *reference = _smsRef;
+    }
+    return true;
+}
+
+void GSM::vSendMessage(const char number[], const char message[])
+{
+    if (_smsState == SMS_SEND_WAIT_PROMPT || _smsState == SMS_SEND_WAIT_REF)
+    {
+        if (_debug)
+        {
+            Serial.println(F("SMS send already in progress"));
+        }
+        return;
+    }
+
+    size_t frame_len;
+    uint8_t *frame = _compress ? _compressText(message, &frame_len) : NULL;
+    if (frame && (frame_len + 2) / 3 * 4 <= SMS_MAX_BODY_SIZE)
+    {
+        _TextBuffer body(_smsBody, sizeof(_smsBody));
+        _writeEncoded(&body, frame, frame_len, PAYLOAD_BASE64);
+    }
+    else
+    {
+        strncpy(_smsBody, message, SMS_MAX_BODY_SIZE);
+        _smsBody[SMS_MAX_BODY_SIZE] = '\0';
     }
+    free(frame);
+    strncpy(_smsNumber, number, sizeof(_smsNumber) - 1);
+    _smsNumber[sizeof(_smsNumber) - 1] = '\0';
+    _smsRef = -1;
+    _smsError = CMS_ERROR_NONE;
+    _smsPart = 1;
+    _smsParts = _pduMode ? pduSegmentCount(_smsBody, nullptr) : 1;
+    _smsConcatRef++;
+
+    _smsSendPart();
 }
 
-void GSM::errorPrintCMS(int ret)
+void GSM::_smsSendPart()
 {
+    _smsState = SMS_SEND_WAIT_PROMPT;
+    _smsStartMS = millis();
 
-    switch (ret)
+    if (_pduMode)
+    {
+        _gsm->print(F("AT+CMGS="));
+        _gsm->print(pduEncodeSubmit(nullptr, _smsNumber, _smsBody, _smsPart, _smsConcatRef, _smsReports));
+        _gsm->print(F("\r\n"));
+    }
+    else
+    {
+        _gsm->print(F("AT+CMGS=\""));
+        _gsm->print(_smsNumber);
+        _gsm->print(F("\"\r\n"));
+    }
+}
+
+void GSM::_smsOnPrompt()
+{
+    if (_pduMode)
+    {
+        char hex[PDU_MAX_HEX_SIZE];
+        pduEncodeSubmit(hex, _smsNumber, _smsBody, _smsPart, _smsConcatRef, _smsReports);
+        _gsm->print(hex);
+    }
+    else
+    {
+        _gsm->print(_smsBody);
+    }
+    _gsm->write(0x1a);
+    _smsState = SMS_SEND_WAIT_REF;
+    _smsStartMS = millis();
+}
+
+void GSM::_smsCheckPrompt()
+{
+    // The SMS prompt is "> " without a line end.
+    if (_smsState == SMS_SEND_WAIT_PROMPT && _rx.pending() && _rx.peek()[0] == '>')
+    {
+        _rx.consume(_rx.pending() > 1 && _rx.peek()[1] == ' ' ? 2 : 1);
+        _smsOnPrompt();
+    }
+}
+
+bool GSM::_smsOnTerm(uint8_t term_id, const char data[])
+{
+    if (_smsState != SMS_SEND_WAIT_PROMPT && _smsState != SMS_SEND_WAIT_REF)
+    {
+        return false;
+    }
+
+    if (term_id == TERM_CMGS && _smsState == SMS_SEND_WAIT_REF)
+    {
+        _smsRef = atoi(data);
+        if (_smsPart < _smsParts)
+        {
+            _smsPart++;
+            _smsSendPart();
+        }
+        else
+        {
+            _smsState = SMS_SEND_DONE;
+        }
+    }
+    else if (term_id == TERM_CMS)
+    {
+        _smsError = atoi(data);
+        _smsState = SMS_SEND_FAILED;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void GSM::_smsReadPoll()
+{
+    if (!_smsReadCount || _smsState == SMS_SEND_WAIT_PROMPT || _smsState == SMS_SEND_WAIT_REF || _asyncWaiting())
+    {
+        return;
+    }
+    uint8_t index = _smsReadQueue[0];
+    _smsReadCount--;
+    memmove(_smsReadQueue, _smsReadQueue + 1, _smsReadCount);
+    ReadMessage(index);
+}
+
+void GSM::_smsCheckTimeout()
+{
+    if (_smsState == SMS_SEND_WAIT_PROMPT && millis() - _smsStartMS >= SMS_PROMPT_TIMEOUT_MS)
+    {
+        // Cancel the pending prompt so the module does not swallow the next command as SMS text.
+        _gsm->write(0x1b);
+        _smsState = SMS_SEND_TIMEOUT;
+    }
+    else if (_smsState == SMS_SEND_WAIT_REF && millis() - _smsStartMS >= SMS_SEND_TIMEOUT_MS)
+    {
+        _smsState = SMS_SEND_TIMEOUT;
+    }
+}
+
+int GSM::QueueMessage(const char number[], const char message[])
+{
+    int8_t slot = -1;
+    for (uint8_t i = 0; i < SMS_OUTBOX_SIZE; i++)
+    {
+        if (!_outbox[i].used)
+        {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0)
+    {
+        return -1;
+    }
+
+    int8_t body = -1;
+    for (uint8_t i = 0; i < SMS_OUTBOX_BODIES && body < 0; i++)
+    {
+        if (_outboxBodyRefs[i] && !strncmp(_outboxBodies[i], message, SMS_MAX_BODY_SIZE))
+        {
+            body = i;
+        }
+    }
+    for (uint8_t i = 0; i < SMS_OUTBOX_BODIES && body < 0; i++)
+    {
+        if (!_outboxBodyRefs[i])
+        {
+            strncpy(_outboxBodies[i], message, SMS_MAX_BODY_SIZE);
+            _outboxBodies[i][SMS_MAX_BODY_SIZE] = '\0';
+            body = i;
+        }
+    }
+    if (body < 0)
+    {
+        return -1;
+    }
+    _outboxBodyRefs[body]++;
+
+    SMS_Outbox_Entry_t *entry = &_outbox[slot];
+    entry->used = true;
+    entry->id = _outboxNextId++;
+    strncpy(entry->number, number, sizeof(entry->number) - 1);
+    entry->number[sizeof(entry->number) - 1] = '\0';
+    entry->body = body;
+    entry->attempts = 0;
+    entry->dueMS = millis();
+    return entry->id;
+}
+
+uint8_t GSM::GetOutboxCount()
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < SMS_OUTBOX_SIZE; i++)
+    {
+        if (_outbox[i].used)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void GSM::SetMessageInterval(unsigned long interval_ms)
+{
+    _outboxIntervalMS = interval_ms;
+}
+
+AT_Result_t GSM::EnableDeliveryReports()
+{
+    _smsWaitIdle();
+    _gsm->println(F("AT+CNMI=0,1,0,1,0"));
+    AT_Result_t result = _checkResponse(CMD_CNMI);
+    if (!result)
+    {
+        return result;
+    }
+    // Text mode: first octet 49 = SMS-SUBMIT, relative validity period, TP-SRR. PDU mode sets TP-SRR itself.
+    _gsm->println(F("AT+CSMP=49,167,0,0"));
+    result = _checkResponse(CMD_CSMP);
+    if (result)
+    {
+        _smsReports = true;
+    }
+    return result;
+}
+
+static bool _isTransientCMSError(int error)
+{
+    switch (error)
     {
-    case UNASSIGNED_NUM:
-        Serial.printf("UNASSIGNED_NUM\n");
-        break;
-    case OPER_DETERM_BARR:
-        Serial.printf("OPER_DETERM_BARR\n");
-        break;
-    case CALL_BARRED:
-        Serial.printf("CALL_BARRED\n");
-        break;
-    case SM_TRANS_REJE:
-        Serial.printf("SM_TRANS_REJE\n");
-        break;
-    case DEST_OOS:
-        Serial.printf("DEST_OOS\n");
-        break;
-    case UNINDENT_SUB:
-        Serial.printf("UNINDENT_SUB\n");
-        break;
-    case FACILIT_REJE:
-        Serial.printf("FACILIT_REJE\n");
-        break;
-    case UNKONWN_SUB:
-        Serial.printf("UNKONWN_SUB\n");
-        break;
     case NW_OOO:
-        Serial.printf("NW_OOO\n");
-        break;
     case TMEP_FAIL:
-        Serial.printf("TMEP_FAIL\n");
-        break;
     case CONGESTION:
-        Serial.printf("CONGESTION\n");
-        break;
     case RES_UNAVAILABLE:
-        Serial.printf("RES_UNAVAILABLE\n");
-        break;
-    case REQ_FAC_NOT_SUB:
-        Serial.printf("REQ_FAC_NOT_SUB\n");
-        break;
-    case RFQ_FAC_NOT_IMP:
-        Serial.printf("RFQ_FAC_NOT_IMP\n");
-        break;
-    case INVALID_SM_TRV:
-        Serial.printf("INVALID_SM_TRV\n");
-        break;
-    case INVALID_MSG:
-        Serial.printf("INVALID_MSG\n");
-        break;
-    case INVALID_MAND_INFO:
-        Serial.printf("INVALID_MAND_INFO\n");
-        break;
-    case MSG_TYPE_ERROR:
-        Serial.printf("MSG_TYPE_ERROR\n");
-        break;
-    case MSG_NOT_COMP:
-        Serial.printf("MSG_NOT_COMP\n");
-        break;
-    case INFO_ELEMENT_ERROR:
-        Serial.printf("INFO_ELEMENT_ERROR\n");
-        break;
-    case PROT_ERROR:
-        Serial.printf("PROT_ERROR\n");
-        break;
-    case IW_UNSPEC:
-        Serial.printf("IW_UNSPEC\n");
-        break;
-    case TEL_IW_NOT_SUPP:
-        Serial.printf("TEL_IW_NOT_SUPP\n");
-        break;
-    case SMS_TYPE0_NOT_SUPP:
-        Serial.printf("SMS_TYPE0_NOT_SUPP\n");
-        break;
-    case CANNOT_REP_SMS:
-        Serial.printf("CANNOT_REP_SMS\n");
-        break;
-    case UNSPEC_TP_ERROR:
-        Serial.printf("UNSPEC_TP_ERROR\n");
-        break;
-    case DCS_NOT_SUPP:
-        Serial.printf("DCS_NOT_SUPP\n");
-        break;
-    case MSG_CLASS_NOT_SUPP:
-        Serial.printf("MSG_CLASS_NOT_SUPP\n");
-        break;
-    case UNSPEC_TD_ERROR:
-        Serial.printf("UNSPEC_TD_ERROR\n");
-        break;
-    case CMD_CANNOT_ACT:
-        Serial.printf("CMD_CANNOT_ACT\n");
-        break;
-    case CMD_UNSUPP:
-        Serial.printf("CMD_UNSUPP\n");
-        break;
-    case UNSPEC_TC_ERROR:
-        Serial.printf("UNSPEC_TC_ERROR\n");
-        break;
-    case TPDU_NOT_SUPP:
-        Serial.printf("TPDU_NOT_SUPP\n");
-        break;
     case SC_BUSY:
-        Serial.printf("SC_BUSY\n");
-        break;
-    case NO_SC_SUB:
-        Serial.printf("NO_SC_SUB\n");
-        break;
-    case SC_SYS_FAIL:
-        Serial.printf("SC_SYS_FAIL\n");
-        break;
-    case INVALID_SME_ADDR:
-        Serial.printf("INVALID_SME_ADDR\n");
-        break;
-    case DEST_SME_BARR:
-        Serial.printf("DEST_SME_BARR\n");
-        break;
-    case SM_RD_SM:
-        Serial.printf("SM_RD_SM\n");
-        break;
-    case TP_VPF_NOT_SUPP:
-        Serial.printf("TP_VPF_NOT_SUPP\n");
-        break;
-    case TP_VP_NOT_SUPP:
-        Serial.printf("TP_VP_NOT_SUPP\n");
-        break;
-    case D0_SIM_SMS_STO_FULL:
-        Serial.printf("D0_SIM_SMS_STO_FULL\n");
-        break;
-    case NO_SMS_STO_IN_SIM:
-        Serial.printf("NO_SMS_STO_IN_SIM\n");
-        break;
-    case ERR_IN_MS:
-        Serial.printf("ERR_IN_MS\n");
-        break;
-    case MEM_CAP_EXCCEEDED:
-        Serial.printf("MEM_CAP_EXCCEEDED\n");
-        break;
     case SIM_APP_TK_BUSY:
-        Serial.printf("SIM_APP_TK_BUSY\n");
-        break;
-    case SIM_DATA_DL_ERROR:
-        Serial.printf("SIM_DATA_DL_ERROR\n");
-        break;
-    case UNSPEC_ERRO_CAUSE:
-        Serial.printf("UNSPEC_ERRO_CAUSE\n");
-        break;
-    case ME_FAIL:
-        Serial.printf("ME_FAIL\n");
-        break;
-    case SMS_SERVIEC_RESERVED:
-        Serial.printf("SMS_SERVIEC_RESERVED\n");
-        break;
-    case OPER_NOT_SUPP:
-        Serial.printf("OPER_NOT_SUPP\n");
-        break;
-    case INVALID_PDU_PARAM:
-        Serial.printf("INVALID_PDU_PARAM\n");
-        break;
-    case INVALID_TXT_PARAM:
-        Serial.printf("INVALID_TXT_PARAM\n");
-        break;
-    case SIM_NOT_INSERT:
-        Serial.printf("SIM_NOT_INSERT\n");
-        break;
-    case CMS_SIM_PIN_REQUIRED:
-        Serial.printf("SIM_PIN_REQUIRED\n");
-        break;
-    case PH_SIM_PIN_REQUIRED:
-        Serial.printf("PH_SIM_PIN_REQUIRED\n");
-        break;
-    case SIM_FAIL:
-        Serial.printf("SIM_FAIL\n");
-        break;
     case CMS_SIM_BUSY:
-        Serial.printf("SIM_BUSY\n");
-        break;
-    case CMS_SIM_WRONG:
-        Serial.printf("SIM_WRONG\n");
-        break;
-    case CMS_SIM_PUK_REQUIRED:
-        Serial.printf("SIM_PUK_REQUIRED\n");
-        break;
-    case CMS_SIM_PIN2_REQUIRED:
-        Serial.printf("SIM_PIN2_REQUIRED\n");
-        break;
-    case CMS_SIM_PUK2_REQUIRED:
-        Serial.printf("SIM_PUK2_REQUIRED\n");
-        break;
-    case MEM_FAIL:
-        Serial.printf("MEM_FAIL\n");
-        break;
-    case INVALID_MEM_INDEX:
-        Serial.printf("INVALID_MEM_INDEX\n");
-        break;
-    case MEM_FULL:
-        Serial.printf("MEM_FULL\n");
-        break;
-    case SCA_ADDR_UNKNOWN:
-        Serial.printf("SCA_ADDR_UNKNOWN\n");
-        break;
     case NO_NW_SERVICE:
-        Serial.printf("NO_NW_SERVICE\n");
-        break;
     case NW_TIMEOUT:
-        Serial.printf("NW_TIMEOUT\n");
-        break;
-    case NO_CNMA_ACK_EXPECTED:
-        Serial.printf("NO_CNMA_ACK_EXPECTED\n");
-        break;
-    case UNKNOWN_ERROR:
-        Serial.printf("UNKNOWN_ERROR\n");
-        break;
-    case USER_ABORT:
-        Serial.printf("USER_ABORT\n");
-        break;
-    case UNABLE_TO_STORE:
-        Serial.printf("UNABLE_TO_STORE\n");
-        break;
-    case INVALID_STATUS:
-        Serial.printf("INVALID_STATUS\n");
-        break;
-    case INVALID_ADDR_CHAR:
-        Serial.printf("INVALID_ADDR_CHAR\n");
-        break;
-    case INVALID_LEN:
-        Serial.printf("INVALID_LEN\n");
-        break;
-    case INVALID_PDU_CHAR:
-        Serial.printf("INVALID_PDU_CHAR\n");
-        break;
-    case INVALID_PARA:
-        Serial.printf("INVALID_PARA\n");
-        break;
-    case INVALID_LEN_OR_CHAR:
-        Serial.printf("INVALID_LEN_OR_CHAR\n");
-        break;
-    case INVALID_TXT_CHAR:
-        Serial.printf("INVALID_TXT_CHAR\n");
-        break;
     case TIMER_EXPIRED:
-        Serial.printf("TIMER_EXPIRED\n");
-        break;
+        return true;
     default:
-        break;
+        return false;
+    }
+}
+
+void GSM::_outboxPoll()
+{
+    bool sending = _smsState == SMS_SEND_WAIT_PROMPT || _smsState == SMS_SEND_WAIT_REF;
+
+    if (_outboxCurrent >= 0)
+    {
+        if (sending)
+        {
+            return;
+        }
+
+        SMS_Outbox_Entry_t *entry = &_outbox[_outboxCurrent];
+        if (_smsState == SMS_SEND_DONE)
+        {
+            if (_smsReports)
+            {
+                _reports[_reportNext].used = true;
+                _reports[_reportNext].mr = _smsRef;
+                _reports[_reportNext].id = entry->id;
+                _reportNext = (_reportNext + 1) % SMS_REPORT_SLOTS;
+            }
+            _outboxFinish(_outboxCurrent, 0);
+        }
+        else
+        {
+            int error = _smsState == SMS_SEND_TIMEOUT ? TIMER_EXPIRED : _smsError;
+            if (_isTransientCMSError(error) && entry->attempts < SMS_OUTBOX_RETRIES)
+            {
+                entry->dueMS = millis() + SMS_OUTBOX_RETRY_DELAY_MS;
+            }
+            else
+            {
+                _outboxFinish(_outboxCurrent, error);
+            }
+        }
+        _outboxCurrent = -1;
+    }
+
+    if (sending || millis() - _outboxLastMS < _outboxIntervalMS)
+    {
+        return;
+    }
+
+    int8_t next = -1;
+    for (uint8_t i = 0; i < SMS_OUTBOX_SIZE; i++)
+    {
+        SMS_Outbox_Entry_t *entry = &_outbox[i];
+        if (!entry->used || (long)(millis() - entry->dueMS) < 0)
+        {
+            continue;
+        }
+        if (next < 0 || (int16_t)(entry->id - _outbox[next].id) < 0)
+        {
+            next = i;
+        }
+    }
+    if (next < 0)
+    {
+        return;
+    }
+
+    SMS_Outbox_Entry_t *entry = &_outbox[next];
+    entry->attempts++;
+    _outboxCurrent = next;
+    _outboxLastMS = millis();
+    vSendMessage(entry->number, _outboxBodies[entry->body]);
+}
+
+void GSM::_outboxFinish(int8_t slot, int error)
+{
+    SMS_Outbox_Entry_t *entry = &_outbox[slot];
+    _outboxDispatch(EVENT_SMS_SENT, entry->id, entry->number, error);
+    _outboxBodyRefs[entry->body]--;
+    entry->used = false;
+}
+
+void GSM::_outboxDispatch(Event_ID_t id, uint16_t outbox_id, const char number[], int error)
+{
+    if (!_eventCallback)
+    {
+        return;
+    }
+
+    A9G_Event_t *event = (A9G_Event_t *)malloc(sizeof(A9G_Event_t));
+    if (!event)
+    {
+        return;
+    }
+    _clearEvent(event, id);
+    event->param1 = outbox_id;
+    event->error = error;
+    strncpy(event->number, number, sizeof(event->number) - 1);
+    event->number[sizeof(event->number) - 1] = '\0';
+    _eventCallback(event);
+    free(event);
+}
+
+int GSM::_reportLookup(uint8_t mr)
+{
+    // Newest first: message references wrap at 256.
+    for (uint8_t i = 1; i <= SMS_REPORT_SLOTS; i++)
+    {
+        SMS_Report_Slot_t *slot = &_reports[(_reportNext + SMS_REPORT_SLOTS - i) % SMS_REPORT_SLOTS];
+        if (slot->used && slot->mr == mr)
+        {
+            slot->used = false;
+            return slot->id;
+        }
+    }
+    return -1;
+}
+
+SMS_Send_State_t GSM::GetSMSSendState()
+{
+    return _smsState;
+}
+
+int GSM::GetSMSReference()
+{
+    return _smsRef;
+}
+
+int GSM::GetSMSError()
+{
+    return _smsError;
+}
+#endif
+
+
+void GSM::errorPrintCME(int ret)
+{
+    const char *name = cmeErrorName(ret);
+    if (name)
+    {
+        Serial.println((const __FlashStringHelper *)name);
+    }
+    else
+    {
+        Serial.println(ret);
+    }
+}
+
+void GSM::errorPrintCMS(int ret)
+{
+    const char *name = cmsErrorName(ret);
+    if (name)
+    {
+        Serial.println((const __FlashStringHelper *)name);
     }
-}
\ No newline at end of file
+    else
+    {
+        Serial.println(ret);
+    }
+}
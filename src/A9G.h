@@ -32,11 +32,130 @@
 #include <Arduino.h>
 #include <Stream.h>
 #include "A9G_Event.h"
+#ifndef A9G_NO_SMS
+#include "A9G_PDU.h"
+#endif
+#include "A9G_Error.h"
+#include "A9G_Latency.h"
+#include "A9G_Tap.h"
+#include "A9G_RxBuffer.h"
+#include "A9G_Compress.h"
+#include "A9G_EventLane.h"
+
+/*
+ * Feature selection. Define these for the whole build (e.g. PlatformIO build_flags = -DA9G_NO_MQTT) so the
+ * library sources see the same configuration as the sketch:
+ *
+ *   A9G_NO_SMS          SMS send/receive, the PDU codec, the outbox and the SMS terms
+ *   A9G_NO_MQTT         the MQTT commands and the MQTTPUBLISH term
+ *   A9G_NO_GPS          the GPSRD, AGPS and GPNT terms
+ *   A9G_NO_HTTP         HTTPGet() and HTTPPost()
+ *   A9G_NO_ERROR_NAMES  the CME/CMS name tables, see A9G_Error.h
+ *   A9G_NO_EVENT_LANES  the event priority lanes (3 x EVENT_LANE_SIZE bytes) and status coalescing, events go
+ *                       out in arrival order
+ *   A9G_NO_LATENCY      the per command latency statistics (about 20 bytes per AT_Command_t) and the histograms
+ *                       in Metrics_t, commands keep their default timeouts
+ *
+ * The larger buffers are sized the same way: RX_BUFFER_SIZE (the longest line kept whole with its CR/LF, 512),
+ * SIGNAL_HISTORY_SIZE (16 samples, 0 keeps only the latest) and EVENT_LANE_SIZE.
+ *
+ * Terms that are compiled out are counted as unknown and never dispatched.
+ */
 
 #define MAX_WAIT_TIME_MS 60000
-#define MAX_TERM_SIZE 100
-#define MAX_AT_RESPONSE_SIZE 128
-#define MAX_MSG_SIZE 128
+#define ADAPTIVE_TIMEOUT_MIN_SAMPLES 8      // samples needed before the learned timeout replaces the default
+#define ADAPTIVE_TIMEOUT_MARGIN_MS 250      // added on top of the observed p99
+#define ADAPTIVE_TIMEOUT_MIN_MS 300
+#define ADAPTIVE_TIMEOUT_MAX_FACTOR 2      // the learned timeout stays within this multiple of the default
+#define METRICS_FORMAT_VERSION 2
+
+#ifndef READY_TIMEOUT_MS
+#define READY_TIMEOUT_MS 30000              // time allowed from power on or BeginReadyWait() to READY
+#endif
+#ifndef READY_POLL_MS
+#define READY_POLL_MS 3000                  // AT+CPIN? interval while waiting, catches a module that booted earlier
+#endif
+#ifndef READY_MAX_POWER_CYCLES
+#define READY_MAX_POWER_CYCLES 2            // power cycles tried on timeout before giving up
+#endif
+#define READY_BANNER "Init"                 // start of the first line printed after power on
+
+#ifndef SIGNAL_HISTORY_SIZE
+#define SIGNAL_HISTORY_SIZE 16              // +CSQ samples kept, see GetSignalHistory(), 0 keeps only the latest
+#endif
+#define SIGNAL_IDLE_GAP_MS 500              // quiet time after a command before a background poll is sent
+#define ASYNC_REPLY_TIMEOUT_MS 5000         // a background poll without final result code is forgotten after this
+
+#ifndef A9G_NO_EVENT_LANES
+#define EVENT_PULL_LINES 16                 // lines moved from the RX buffer into the lanes per executeCallback()
+#ifndef COALESCE_WINDOW_MS
+#define COALESCE_WINDOW_MS 500              // status terms are held this long and only the latest is delivered
+#endif
+#define COALESCE_SLOTS 4                    // status terms that can be coalesced at the same time
+#define COALESCE_DATA_SIZE 48               // longer status lines are delivered as they are
+#endif
+
+#ifndef SLEEP_WAKE_IDLE_MS
+#define SLEEP_WAKE_IDLE_MS 1000             // in sleep mode, quiet time after which the module is woken before a command
+#endif
+#ifndef SLEEP_WAKE_DELAY_MS
+#define SLEEP_WAKE_DELAY_MS 100             // time the module needs between the wake byte and the command
+#endif
+
+#ifndef A9G_NO_MQTT
+#ifndef MQTT_QUEUE_SIZE
+#define MQTT_QUEUE_SIZE 8                   // publishes held by QueuePublish()
+#endif
+#ifndef MQTT_QUEUE_TOPIC_SIZE
+#define MQTT_QUEUE_TOPIC_SIZE 64
+#endif
+#ifndef MQTT_QUEUE_PAYLOAD_SIZE
+#define MQTT_QUEUE_PAYLOAD_SIZE 256
+#endif
+#define MQTT_QUEUE_MAX_DELAY_MS 600000      // default time a non-urgent publish may be held
+#define MQTT_QUEUE_RSSI_MIN 15              // +CSQ rssi from which held publishes are sent, about -83 dBm
+#define MQTT_QUEUE_RETRIES 3
+#define MQTT_QUEUE_RETRY_DELAY_MS 10000
+#ifndef MQTT_DEDUP_WINDOW_MS
+#define MQTT_DEDUP_WINDOW_MS 0              // a redelivered +MQTTPUBLISH within this time is dropped, 0 is off
+#endif
+#define MQTT_DEDUP_SIZE 8                   // recent deliveries remembered
+#endif
+
+#ifndef A9G_NO_HTTP
+#ifndef HTTP_IDLE_TIMEOUT_MS
+#define HTTP_IDLE_TIMEOUT_MS 10000          // silence that ends a response body
+#endif
+#define HTTP_FINAL_TIMEOUT_MS 1000          // wait for an OK that follows the body
+#ifndef HTTP_POST_MAX_SIZE
+#define HTTP_POST_MAX_SIZE 512              // longest request body HTTPPost() sends
+#endif
+#define HTTP_DRAIN_QUIET_MS 200             // silence after which the rest of an abandoned body is assumed gone
+#endif
+
+#ifndef A9G_NO_SMS
+#ifndef SMS_MAX_BODY_SIZE
+#define SMS_MAX_BODY_SIZE 480 // UTF-8 bytes; in PDU mode longer bodies are sent as concatenated SMS
+#endif
+#define SMS_PROMPT_TIMEOUT_MS 5000
+#define SMS_SEND_TIMEOUT_MS 60000
+
+#ifndef SMS_OUTBOX_SIZE
+#define SMS_OUTBOX_SIZE 16                  // queued messages (one per recipient)
+#endif
+#ifndef SMS_OUTBOX_BODIES
+#define SMS_OUTBOX_BODIES 4                 // distinct message bodies, shared by recipients of the same text
+#endif
+#ifndef SMS_REPORT_SLOTS
+#define SMS_REPORT_SLOTS 16                 // sent messages still waiting for a +CDS delivery report
+#endif
+#ifndef SMS_READ_QUEUE_SIZE
+#define SMS_READ_QUEUE_SIZE 4               // +CMTI indexes waiting for the send in progress to finish
+#endif
+#define SMS_OUTBOX_INTERVAL_MS 3000
+#define SMS_OUTBOX_RETRIES 3                // attempts per message, the first one included
+#define SMS_OUTBOX_RETRY_DELAY_MS 10000
+#endif
 
 
 /**
@@ -54,6 +173,7 @@ private:
 
     typedef void (*EventDispatchCallback)(A9G_Event_t *event);
     EventDispatchCallback _eventCallback = nullptr;
+    typedef void (*PowerCycleCallback)();
 
     /**
      * @brief
@@ -80,18 +200,247 @@ private:
         TERM_CSQ,
         TERM_EGMR,
         TERM_CCID,
+        TERM_CDS,
+        TERM_CGDCONT,
+        TERM_CGACT,
+        TERM_CPIN,
         TERM_MAX,
         TERM_NONE
     } Term_List_t;
 
-    const char _terms_string[25][15] = {"CREG", "CTZV", "CIEV", "CPMS", "CMT", "CMTI", "CMGL", "CMGR", "GPSRD", "CGATT", "AGPS", "GPNT", "MQTTPUBLISH", "CMGS", "CME ERROR", "CMS ERROR", "CSQ","EGMR","CCID"};
+    static const char _terms_string[TERM_MAX][12]; // in flash, empty for terms that are compiled out
 
+public:
+    /**
+     * @brief Counters of the AT engine, see GetMetrics().
+     */
+    typedef struct Counters_t
+    {
+        uint32_t bytes_read;
+        uint32_t bytes_written;
+        uint32_t terms[TERM_MAX];           // "+TERM" lines seen per type, indexed like Event_ID_t
+        uint32_t unknown_terms;             // "+TERM" lines not in the term list
+        uint32_t overflows;                 // lines truncated because they exceeded RX_BUFFER_SIZE
+        uint32_t rx_overruns;               // UART receive overruns reported by the transport, bytes were lost
+        uint32_t commands;
+        uint32_t command_errors;            // ERROR, +CME ERROR or +CMS ERROR
+        uint32_t command_timeouts;
+        uint32_t blocked_ms;                // total time spent waiting in _checkResponse()
+    } Counters_t;
+
+    /**
+     * @brief The counters with the latency histograms, filled in by GetMetrics() only.
+     */
+    typedef struct Metrics_t : Counters_t
+    {
+#ifndef A9G_NO_LATENCY
+        uint8_t latency[CMD_MAX][LATENCY_BUCKETS]; // per command latency histograms, see AT_Latency
+#endif
+    } Metrics_t;
+
+private:
+    A9G_StreamTransport _streamTransport;
+    A9G_Tap _tap;
+    A9G_RxBuffer _rx;
+    Counters_t _metrics;
+
+    void _countResult(const AT_Result_t &result);
     uint8_t _checkTermFromString(const char *term_str);
-    void _processTermString(A9G_Event_t *event, const char data[], int data_len);
-    bool _checkResponse(const int timeout); //  it will be private. need to fix timeout
+    bool _processTermString(A9G_Event_t *event, char data[], int data_len);
+    char *_nextLine(size_t *len, unsigned long timeout);
+    uint8_t _termFromLine(char line[], char **data, int *data_len);
+    void _dispatchTerm(A9G_Event_t *event, uint8_t term_id, char data[], int data_len);
+    void _trackTerm(uint8_t term_id, const char data[]);
+    void _deliverTerm(A9G_Event_t *event, uint8_t term_id, char data[], int data_len);
+    AT_Latency _latency;
+    unsigned long _timeoutOverride[CMD_MAX];
+
+    AT_Result_t _checkResponse(AT_Command_t cmd);
+    void _recordTimeout(AT_Command_t cmd, unsigned long latency_ms);
+    void _smsWaitIdle();
+    AT_Status_t _finalResultCode(const char line[], int *error);
+    AT_Result_t _lastResult = {AT_OK, 0, 0};
     bool _checkOk(const int timeout);
     bool _sms;
     int _sms_i;
+    bool _resumed = false;
+    bool _compress = false;
+    uint32_t _overrunsBase = 0; // transport overruns at the last ResetMetrics()
+    A9G_State_t _localState;
+    A9G_State_t *_state = &_localState;
+
+    void _stateReset(A9G_State_t *state);
+    void _stateSave();
+    void _stateOnTerm(uint8_t term_id, const char data[]);
+
+    Ready_State_t _readyState = READY_UNKNOWN;
+    unsigned long _readyTimeoutMS = READY_TIMEOUT_MS;
+    unsigned long _readyStartMS = 0;
+    unsigned long _readyPollMS = 0;
+    uint8_t _readyCycles = 0;
+    PowerCycleCallback _powerCycle = nullptr;
+
+    void _readySet(Ready_State_t state);
+    void _readyOnLine(const char line[]);
+    void _readyOnTerm(uint8_t term_id, const char data[]);
+    void _readyPoll();
+
+    bool _asyncPending = false;             // a background request's final result code is still to come, one at a time
+    unsigned long _asyncSentMS = 0;
+    unsigned long _asyncTimeoutMS = ASYNC_REPLY_TIMEOUT_MS;
+    unsigned long _lastCommandMS = 0;
+
+    void _asyncSent(unsigned long timeout_ms = ASYNC_REPLY_TIMEOUT_MS);
+    bool _asyncWaiting();
+    void _asyncCancel();
+    bool _asyncOnFinal(AT_Status_t status, int error);
+
+    Signal_Sample_t _signalNow;
+    bool _signalSeen = false;
+#if SIGNAL_HISTORY_SIZE > 0
+    Signal_Sample_t _signalHistory[SIGNAL_HISTORY_SIZE];
+    uint8_t _signalHead = 0;
+    uint8_t _signalCount = 0;
+#endif
+    unsigned long _signalIntervalMS = 0;
+    unsigned long _signalLastMS = 0;
+
+    void _signalOnTerm(uint8_t term_id, const char data[]);
+    void _signalPoll();
+
+#ifndef A9G_NO_EVENT_LANES
+    A9G_EventLane _lanes[EVENT_PRIORITY_MAX];
+    uint8_t _termPriority[TERM_MAX];        // Event_Priority_t per term
+    const char *_controlTopic = nullptr;
+
+    typedef struct Coalesce_Slot_t
+    {
+        uint8_t term_id;            // TERM_NONE when free
+        bool pending;
+        uint8_t len;
+        unsigned long first_ms;     // arrival of the first pending line
+        unsigned long last_ms;      // last delivery
+        uint32_t last_hash;         // data of the last delivery
+        char data[COALESCE_DATA_SIZE];
+    } Coalesce_Slot_t;
+
+    Coalesce_Slot_t _coalesce[COALESCE_SLOTS];
+    unsigned long _coalesceWindowMS = COALESCE_WINDOW_MS;
+    uint32_t _coalesced = 0;
+
+    bool _coalesceOnTerm(uint8_t term_id, const char data[], size_t len);
+    void _coalescePoll();
+    char *_pullLine(size_t *len);
+    bool _termHasBody(uint8_t term_id);
+    Event_Priority_t _eventPriority(uint8_t term_id, const char data[]);
+    bool _lanesBlocked();
+    bool _laneDispatch();
+#endif
+
+#ifndef A9G_NO_MQTT
+    typedef struct MQTT_Queue_Entry_t
+    {
+        bool used;
+        uint16_t id;
+        uint8_t attempts;
+        unsigned long dueMS;    // sent regardless of signal from here on
+        char topic[MQTT_QUEUE_TOPIC_SIZE];
+        char payload[MQTT_QUEUE_PAYLOAD_SIZE];
+    } MQTT_Queue_Entry_t;
+
+    MQTT_Queue_Entry_t _publishQueue[MQTT_QUEUE_SIZE];
+    uint16_t _publishNextId = 0;
+    uint8_t _publishMinRSSI = MQTT_QUEUE_RSSI_MIN;
+    bool _publishFlushing = false;
+    bool _publishHold = false;          // a failed attempt holds the queue until _publishHoldMS
+    unsigned long _publishHoldMS = 0;
+
+    void _publishPoll();
+    void _publishFinish(uint8_t slot, int error);
+
+    typedef struct MQTT_Dedup_Entry_t
+    {
+        uint32_t hash;
+        unsigned long time_ms;
+    } MQTT_Dedup_Entry_t;
+
+    MQTT_Dedup_Entry_t _dedup[MQTT_DEDUP_SIZE];
+    uint8_t _dedupHead = 0;
+    unsigned long _dedupWindowMS = MQTT_DEDUP_WINDOW_MS;
+    uint32_t _duplicates = 0;
+
+    bool _mqttDuplicate(const char data[], int data_len);
+
+    bool _publishWaiting = false;       // BeginPublish() sent, its final result code is still to come
+    bool _publishDone = false;
+    AT_Result_t _publishResult = {AT_OK, 0, 0};
+
+    void _publishEnd(AT_Status_t status, int error);
+#endif
+
+#ifndef A9G_NO_HTTP
+    AT_Result_t _httpResponse(AT_Command_t cmd, Print *body, HTTP_Response_t *response);
+    bool _httpBody(Print *body, HTTP_Response_t *response);
+    void _httpDrain();
+#endif
+
+#ifndef A9G_NO_SMS
+    SMS_Send_State_t _smsState = SMS_SEND_IDLE;
+    char _smsBody[SMS_MAX_BODY_SIZE + 1];
+    char _smsNumber[PDU_MAX_NUMBER_SIZE];
+    uint8_t _smsPart = 0;
+    uint8_t _smsParts = 0;
+    uint8_t _smsConcatRef = 0;
+    bool _pduMode = false;
+    PDU_Reassembler _smsReassembler;
+    unsigned long _smsStartMS = 0;
+    int _smsRef = -1;
+    int _smsError = CMS_ERROR_NONE;
+    uint8_t _smsReadQueue[SMS_READ_QUEUE_SIZE];
+    uint8_t _smsReadCount = 0;
+
+    typedef struct SMS_Outbox_Entry_t
+    {
+        bool used;
+        uint16_t id;
+        char number[PDU_MAX_NUMBER_SIZE];
+        uint8_t body;           // index into _outboxBodies
+        uint8_t attempts;
+        unsigned long dueMS;
+    } SMS_Outbox_Entry_t;
+
+    typedef struct SMS_Report_Slot_t
+    {
+        bool used;
+        uint8_t mr;
+        uint16_t id;
+    } SMS_Report_Slot_t;
+
+    SMS_Outbox_Entry_t _outbox[SMS_OUTBOX_SIZE];
+    char _outboxBodies[SMS_OUTBOX_BODIES][SMS_MAX_BODY_SIZE + 1];
+    uint8_t _outboxBodyRefs[SMS_OUTBOX_BODIES];
+    SMS_Report_Slot_t _reports[SMS_REPORT_SLOTS];
+    uint8_t _reportNext = 0;
+    uint16_t _outboxNextId = 0;
+    int8_t _outboxCurrent = -1;
+    unsigned long _outboxIntervalMS = SMS_OUTBOX_INTERVAL_MS;
+    unsigned long _outboxLastMS = 0;
+    bool _smsReports = false;
+
+    void _outboxPoll();
+    void _outboxFinish(int8_t slot, int error);
+    void _outboxDispatch(Event_ID_t id, uint16_t outbox_id, const char number[], int error);
+    int _reportLookup(uint8_t mr);
+    bool _processPDUMessage(A9G_Event_t *event);
+    bool _processStatusReport(A9G_Event_t *event, const char data[], int data_len);
+
+    void _smsSendPart();
+    void _smsOnPrompt();
+    void _smsCheckPrompt();
+    bool _smsOnTerm(uint8_t term_id, const char data[]);
+    void _smsCheckTimeout();
+    void _smsReadPoll();
+#endif
 
 public:
     GSM(bool debug);
@@ -104,6 +453,15 @@ public:
      * @param baudRate The communication baud rate for the GSM module.
      */
     void init(Stream *gsm);
+
+    /**
+     * @brief Initialize the GSM module on a transport, e.g. an A9G_UartTransport.
+     *
+     * The transport is used instead of a Stream for all module I/O and must outlive the GSM.
+     *
+     * @param transport The transport connected to the module.
+     */
+    void init(A9G_Transport *transport);
     void Test(char *data);
 
 
@@ -122,9 +480,153 @@ public:
      */
     void executeCallback();
 
+    /**
+     * @brief Overrides the timeout of a command type.
+     *
+     * Without an override the timeout is learned from observed latency: p99 + ADAPTIVE_TIMEOUT_MARGIN_MS,
+     * at least ADAPTIVE_TIMEOUT_MIN_MS and at most ADAPTIVE_TIMEOUT_MAX_FACTOR times the per-command
+     * default (and MAX_WAIT_TIME_MS). Until ADAPTIVE_TIMEOUT_MIN_SAMPLES responses were seen the
+     * default is used. Timeouts are recorded as at most the default, so a dead module keeps failing fast.
+     *
+     * @param cmd The command type.
+     * @param timeout_ms The timeout in milliseconds, 0 to go back to the learned timeout.
+     */
+    void SetCommandTimeout(AT_Command_t cmd, unsigned long timeout_ms);
+
+    /**
+     * @brief Returns the timeout the next command of this type will use, in milliseconds.
+     */
+    unsigned long GetCommandTimeout(AT_Command_t cmd);
+
+    /**
+     * @brief Copies the current engine counters and latency histograms.
+     *
+     * @param metrics Receives the snapshot.
+     */
+    void GetMetrics(Metrics_t *metrics);
+
+    /**
+     * @brief Serialises the metrics as compact binary for telemetry.
+     *
+     * Layout, every value an unsigned LEB128 varint: METRICS_FORMAT_VERSION, bytes_read, bytes_written,
+     * unknown_terms, overflows, rx_overruns, commands, command_errors, command_timeouts, blocked_ms,
+     * TERM_MAX followed by that many term counts, CMD_MAX, LATENCY_BUCKETS followed by the histograms
+     * row by row. With A9G_NO_LATENCY both dimensions are sent as 0 and no histogram follows.
+     *
+     * @param buffer Output buffer.
+     * @param size Size of the buffer.
+     * @return Number of bytes written, 0 if the buffer is too small.
+     */
+    size_t SerializeMetrics(uint8_t buffer[], size_t size);
+
+    /**
+     * @brief Clears the counters. Latency histograms are kept since they drive the command timeouts.
+     */
+    void ResetMetrics();
+
+    /**
+     * @brief Records all UART traffic with the module into a trace, see A9G_Trace.h.
+     *
+     * @param trace A trace started with A9G_Trace::begin(), or nullptr to stop recording.
+     */
+    void SetTrace(A9G_Trace *trace);
+
+    /**
+     * @brief Compresses text payloads of PublishToTopic(), QueuePublish() and the SMS send functions.
+     *
+     * The text is packed into an A9G_Compress.h frame and sent base64 encoded, as with PublishBinary().
+     * Text that would not get shorter is sent unchanged, so the backend decodes base64 and checks for
+     * COMPRESS_MAGIC and COMPRESS_FLAG_LZSS; plain text such as JSON practically never passes that test.
+     * Compressing needs a temporary buffer of compressBound() bytes.
+     *
+     * @param enable true to compress, false (default) to send text as it is.
+     */
+    void SetCompression(bool enable);
+
+#ifndef A9G_NO_EVENT_LANES
+    /**
+     * @brief Sets the priority lane of an event delivered by executeCallback().
+     *
+     * executeCallback() moves up to EVENT_PULL_LINES received lines per call into one lane per
+     * Event_Priority_t and then delivers a single event, from the highest priority lane that has one.
+     * A control event therefore waits for at most one callback, however many GPS or MQTT lines are
+     * pending. Within a lane the arrival order is kept. The module state (registration, signal,
+     * readiness) is updated when a line is read, not when its event is delivered.
+     *
+     * Defaults: +CME ERROR, +CMS ERROR, +CREG, +CPIN and +CGATT are EVENT_PRIORITY_CONTROL, the GPS
+     * terms EVENT_PRIORITY_BULK, everything else EVENT_PRIORITY_NORMAL. Events without a term, such as
+     * EVENT_SMS_SENT, and events of a command that is waiting for its result are delivered at once.
+     * +CMGR and the PDU mode +CDS are followed by a line of their own and are delivered at once too.
+     *
+     * @param id A term event, EVENT_CREG to EVENT_CPIN.
+     * @param priority Its lane.
+     */
+    void SetEventPriority(Event_ID_t id, Event_Priority_t priority);
+
+    /**
+     * @brief Sets what a lane does when it is full, see Lane_Policy_t.
+     *
+     * Defaults: LANE_BLOCK for control and normal, LANE_DROP_OLDEST for bulk. A full LANE_BLOCK lane
+     * stops lines from being read, which also holds back higher priority lines behind them, so give
+     * high volume events a dropping lane.
+     */
+    void SetLanePolicy(Event_Priority_t priority, Lane_Policy_t policy);
+
+    /**
+     * @brief Events dropped by a lane's policy since start.
+     */
+    uint32_t GetLaneDrops(Event_Priority_t priority);
+
+#ifndef A9G_NO_MQTT
+    /**
+     * @brief Delivers +MQTTPUBLISH on topics starting with this prefix as EVENT_PRIORITY_CONTROL.
+     *
+     * @param prefix Topic prefix, kept by the caller; nullptr to turn it off.
+     */
+    void SetControlTopic(const char prefix[]);
+#endif
+
+    /**
+     * @brief Coalesces a status term, or stops doing so.
+     *
+     * A coalesced term is not queued when it arrives. Its first line starts a window of
+     * SetCoalesceWindow() ms; later lines only replace the value, and when the window ends the latest
+     * value is queued into the term's lane. A value equal to the one delivered last, within the same
+     * window length, is not delivered again. The module state is still updated on every line.
+     * +CREG, +CIEV, +CSQ and +CGATT are coalesced by default. Stopping queues a value still held
+     * in the window right away.
+     *
+     * @param id A term event, EVENT_CREG to EVENT_CPIN.
+     * @param enable true to coalesce.
+     * @return false if all COALESCE_SLOTS are taken.
+     */
+    bool SetCoalesce(Event_ID_t id, bool enable);
+
+    /**
+     * @brief Sets the coalescing window, 0 delivers every status line. Default COALESCE_WINDOW_MS.
+     */
+    void SetCoalesceWindow(unsigned long window_ms);
+
+    /**
+     * @brief Status lines that were not delivered because a later or equal value replaced them.
+     */
+    uint32_t GetCoalescedCount();
+#endif
+
+    /**
+     * @brief Result of the last command that waited for a final result code.
+     *
+     * Commands returning AT_Result_t give the same value directly; this also covers
+     * bIsReady(), bSendMessage() and the Read*() helpers.
+     */
+    AT_Result_t GetLastResult();
+
     /**
      * @brief Prints the corresponding error message for CME error codes.
      *
+     * Prints the numeric code when the name is unknown or names are compiled out (A9G_NO_ERROR_NAMES).
+     * Use cmeErrorName() to get the name without printing.
+     *
      * @param ret The CME error code.
      */
     void errorPrintCME(int ret);
@@ -132,7 +634,10 @@ public:
     /**
      * @brief Prints the corresponding error message for CMS error codes.
      *
-     * @param ret The CME error code.
+     * Prints the numeric code when the name is unknown or names are compiled out (A9G_NO_ERROR_NAMES).
+     * Use cmsErrorName() to get the name without printing.
+     *
+     * @param ret The CMS error code.
      */
     void errorPrintCMS(int ret);
 
@@ -152,14 +657,45 @@ public:
     /**
      * @brief Waits for the GSM module to become ready.
      *
-     * This function sends an "AT" command to the GSM module and waits for a response indicating readiness.
-     * Warning: This is a blocking function and may take 15s to 60s to complete. It is not necessary to use this function,
-     * but it may be useful for further operations.
+     * Blocking wrapper around BeginReadyWait(READY_TIMEOUT_MS): runs executeCallback() until the state
+     * leaves READY_BOOTING. With a power cycle hook this can take up to
+     * (READY_MAX_POWER_CYCLES + 1) * READY_TIMEOUT_MS plus the time spent in the hook.
      *
-     * @return True if the GSM module is ready, false otherwise.
+     * @return True if the GSM module is ready, false on NO SIM CARD or timeout.
      */
     bool waitForReady();
 
+    /**
+     * @brief Starts waiting for the module to become ready without blocking.
+     *
+     * Sends "AT" and, every READY_POLL_MS, AT+CPIN? so a module that booted earlier is found too.
+     * executeCallback() moves the state to READY_OK on "READY" or "+CPIN: READY" and to READY_NO_SIM on
+     * "NO SIM CARD". When timeout_ms passes first, the power cycle hook is called and the wait starts
+     * over, at most READY_MAX_POWER_CYCLES times, after which the state is READY_TIMEOUT.
+     * Every change fires EVENT_READY with param1 = the new Ready_State_t.
+     *
+     * The boot banner and READY are also tracked outside a wait: a module that restarts on its own goes
+     * to READY_BOOTING and back to READY_OK, and the cached bearer state (GetState()) is reset.
+     * Do not send other commands while the state is READY_BOOTING.
+     *
+     * @param timeout_ms Time allowed for each attempt.
+     */
+    void BeginReadyWait(unsigned long timeout_ms = READY_TIMEOUT_MS);
+
+    /**
+     * @brief Current readiness, see BeginReadyWait().
+     */
+    Ready_State_t GetReadyState();
+
+    /**
+     * @brief Registers a function that power cycles the module, called when a ready wait times out.
+     *
+     * The function may block, e.g. to pull PWRKEY low for the time the module needs.
+     *
+     * @param powerCycle The hook, or nullptr to give up on the first timeout.
+     */
+    void SetPowerCycle(PowerCycleCallback powerCycle);
+
     /**
      * @brief Reads the IMEI (International Mobile Equipment Identity) from the GSM module.
      */
@@ -168,6 +704,36 @@ public:
     void ReadCSQ();
     void ReadCCID();
 
+    /**
+     * @brief Starts tracking registration, serving cell and signal quality.
+     *
+     * Enables AT+CREG=2 so registration URCs carry the LAC and cell id, then sends AT+CSQ from
+     * executeCallback() every interval_ms, but only in idle gaps: SIGNAL_IDLE_GAP_MS after the last
+     * command, with nothing being received and no SMS pending. A blocking command issued while a poll is
+     * outstanding skips the poll's final result code, so it does not steal its OK.
+     * Every +CSQ, including ReadCSQ(), adds a sample to the history.
+     *
+     * @param interval_ms Time between polls, 0 to stop polling.
+     * @return The result of AT+CREG=2.
+     */
+    AT_Result_t BeginSignalMonitor(unsigned long interval_ms);
+
+    /**
+     * @brief Copies the latest signal reading with the current registration and cell.
+     *
+     * @return false if no +CSQ was received yet.
+     */
+    bool GetSignal(Signal_Sample_t *sample);
+
+    /**
+     * @brief Copies the signal history, oldest sample first.
+     *
+     * @param samples Output array.
+     * @param max Size of the array.
+     * @return Number of samples copied, at most SIGNAL_HISTORY_SIZE.
+     */
+    uint8_t GetSignalHistory(Signal_Sample_t samples[], uint8_t max);
+
     
 
     
@@ -178,52 +744,90 @@ public:
     /**
      * @brief Checks if the GSM module is attached to GPRS (General Packet Radio Service).
      *
-     * @return true if GPRS is attached, false otherwise.
+     * @return The result of AT+CGATT?. status is AT_OK once the module answered; the attach state
+     *         itself comes as +CGATT and is cached. error holds the +CME ERROR code if the query failed.
      */
-    bool IsGPRSAttached();
+    AT_Result_t IsGPRSAttached();
 
     /**
      * @brief Attempts to attach the GSM module to GPRS (General Packet Radio Service).
      *
-     * @return true if the attachment is successful, false otherwise.
+     * @return The result of AT+CGATT=1: AT_OK when attached, otherwise the failing status with its
+     *         +CME ERROR code in error. latency_ms is the time to the final result code.
      */
-    bool AttachToGPRS();
+    AT_Result_t AttachToGPRS();
 
     /**
      * @brief Attempts to detach the GSM module from GPRS (General Packet Radio Service).
      *
-     * @return true if the detachment is successful, false otherwise.
+     * @return The result of AT+CGATT=0, with status, error and latency_ms as for AttachToGPRS().
      */
-    bool DetachToGPRS();
+    AT_Result_t DetachToGPRS();
 
     /**
      * @brief Sets the Access Point Name (APN) and PDP (Packet Data Protocol) type for GPRS connection.
      *
      * @param pdp_type The PDP type.
      * @param apn The Access Point Name.
-     * @return true if the APN is set successfully, false otherwise.
+     * @return The result of AT+CGDCONT; error holds the +CME ERROR code if the module rejected it.
      */
-    bool SetAPN(const char pdp_type[], const char apn[]);
+    AT_Result_t SetAPN(const char pdp_type[], const char apn[]);
 
     /**
      * @brief Activates the Packet Data Protocol (PDP) context for GPRS connection.
      *
-     * @return true if the PDP context is activated successfully, false otherwise.
+     * @return The result of AT+CGACT=1,1. Activation can take several seconds, latency_ms tells how
+     *         long; on failure error holds the +CME ERROR code.
      */
-    bool ActivatePDP();
+    AT_Result_t ActivatePDP();
 
     /**
      * @brief Deactivates the Packet Data Protocol (PDP) context for GPRS connection.
-     * @todo Need to finish this function.
      *
-     * @return true if the PDP context is deactivated successfully, false otherwise.
+     * @return The result of AT+CGACT=0,1: status, the +CME ERROR code in error and latency_ms.
+     */
+    AT_Result_t DeactivatePDP();
+
+    /**
+     * @brief Keeps the module state cache in caller supplied memory, e.g. RTC_NOINIT_ATTR on ESP32.
+     *
+     * The cache is updated from query responses, URCs and successful commands. Content that does not
+     * carry A9G_STATE_MAGIC and a valid checksum is reset to unknown.
+     *
+     * @param store Memory that survives MCU resets.
+     */
+    void SetStateStore(A9G_State_t *store);
+
+    /**
+     * @brief Copies the cached module state.
+     */
+    void GetState(A9G_State_t *state);
+
+    /**
+     * @brief Refreshes the cache with AT+CREG?, AT+CGATT?, AT+CGDCONT? and AT+CGACT?.
+     *
+     * @return The first failing query, or the last result if all succeed.
+     */
+    AT_Result_t QueryState();
+
+    /**
+     * @brief Brings the data bearer up, issuing only the commands whose state differs.
+     *
+     * If the cache says context 1 is active with this APN, a single AT+CGACT? confirms it. Otherwise the
+     * state is queried and AT+CGATT=1, AT+CGDCONT and AT+CGACT=1,1 are sent only where needed. Use this
+     * in place of AttachToGPRS(), SetAPN() and ActivatePDP() after an MCU reset that left the module running.
+     *
+     * @param pdp_type The PDP type.
+     * @param apn The Access Point Name.
+     * @return The result of the last command sent.
      */
-    bool DeactivatePDP();
+    AT_Result_t WarmStart(const char pdp_type[], const char apn[]);
 
+#ifndef A9G_NO_MQTT
     /*###############################################*/
     /*********************  MQTT *********************/
     /*###############################################*/
-    bool ConnectToBroker(const char broker[], int port, const char user[], const char pass[], const char id[], uint8_t keep_alive, uint16_t clean_session);
+    AT_Result_t ConnectToBroker(const char broker[], int port, const char user[], const char pass[], const char id[], uint8_t keep_alive, uint16_t clean_session);
     /**
      * @brief Connects to the MQTT broker with the specified parameters.
      *
@@ -232,25 +836,26 @@ public:
      * @param id The client ID to use for the MQTT connection.
      * @param keep_alive The keep-alive interval for the MQTT connection.
      * @param clean_session The clean session flag for the MQTT connection.
-     * @return true if the connection is successful, false otherwise.
+     * @return The result of AT+MQTTCONN: AT_OK when the broker accepted the connection, otherwise the
+     *         failing status with its +CME ERROR code in error. latency_ms includes the broker round trip.
      */
-    bool ConnectToBroker(const char broker[], int port, const char id[], uint8_t keep_alive, uint16_t clean_session);
+    AT_Result_t ConnectToBroker(const char broker[], int port, const char id[], uint8_t keep_alive, uint16_t clean_session);
 
     /**
      * @brief Connects to the MQTT broker with the specified parameters.
      *
      * @param broker The MQTT broker address.
      * @param port The port number for the MQTT connection.
-     * @return true if the connection is successful, false otherwise.
+     * @return The result of AT+MQTTCONN, as for the overload above.
      */
-    bool ConnectToBroker(const char broker[], int port);
+    AT_Result_t ConnectToBroker(const char broker[], int port);
 
     /**
      * @brief Disconnects from the MQTT broker.
      *
-     * @return true if the disconnection is successful, false otherwise.
+     * @return The result of AT+MQTTDISCONN: status, the +CME ERROR code in error and latency_ms.
      */
-    bool DisconnectBroker();
+    AT_Result_t DisconnectBroker();
 
     /**
      * @brief Subscribes to a topic with the specified quality of service (QoS) level.
@@ -258,37 +863,161 @@ public:
      * @param topic The topic to subscribe to.
      * @param qos The quality of service level (0, 1, or 2).
      * @param timeout The timeout for the subscription operation, in milliseconds.
-     * @return true if the subscription is successful, false otherwise.
+     * @return The result of AT+MQTTSUB: AT_OK once subscribed, otherwise the failing status with its
+     *         +CME ERROR code in error. latency_ms includes the broker round trip.
      */
-    bool SubscribeToTopic(const char topic[], uint8_t qos, unsigned long timeout);
+    AT_Result_t SubscribeToTopic(const char topic[], uint8_t qos, unsigned long timeout);
 
     /**
      * @brief Subscribes to a topic with default quality of service (QoS) level 0.
      *
      * @param topic The topic to subscribe to.
-     * @return true if the subscription is successful, false otherwise.
+     * @return The result of AT+MQTTSUB, as for the overload above.
      */
-    bool SubscribeToTopic(const char topic[]);
+    AT_Result_t SubscribeToTopic(const char topic[]);
 
     /**
      * @brief Unsubscribes from a topic.
      *
      * @param topic The topic to unsubscribe from.
-     * @return true if the unsubscription is successful, false otherwise.
+     * @return The result of AT+MQTTUNSUB: status, the +CME ERROR code in error and latency_ms.
      */
-    bool UnsubscribeToTopic(const char topic[]);
+    AT_Result_t UnsubscribeToTopic(const char topic[]);
 
     /**
      * @brief Publishes a message to a topic.
      *
      * @param topic The topic to publish the message to.
      * @param msg The message to be published.
-     * @return true if the publication is successful, false otherwise.
+     * @return The result of AT+MQTTPUB: AT_OK once the module took the message, otherwise the failing
+     *         status with its +CME ERROR code in error. latency_ms is the time to the final result code.
+     */
+    AT_Result_t PublishToTopic(const char topic[], const char msg[]);
+
+    /**
+     * @brief Publishes binary data such as CBOR or protobuf frames.
+     *
+     * AT+MQTTPUB takes the payload as a quoted string and has no length based form, so the bytes are
+     * sent text encoded and the subscriber decodes them. Encoding happens while the command is written;
+     * nothing is buffered. The module's command line length limits the encoded size.
+     *
+     * @param topic The topic to publish the message to.
+     * @param data The payload, may contain any byte.
+     * @param len Length of the payload.
+     * @param encoding PAYLOAD_BASE64 (default) or PAYLOAD_HEX.
+     * @return The result of AT+MQTTPUB.
+     */
+    AT_Result_t PublishBinary(const char topic[], const uint8_t data[], size_t len, Payload_Encoding_t encoding = PAYLOAD_BASE64);
+
+    /**
+     * @brief Starts a binary publish without waiting for its result.
+     *
+     * The command is written like PublishBinary() and the final result code is picked up by
+     * PollPublish() or any other call that reads from the module, so several GSM instances can each have
+     * a publish in flight. Only one publish per instance can be outstanding.
+     *
+     * @return false if the module is busy (see bIsIdle()) or a publish is still outstanding.
+     */
+    bool BeginPublish(const char topic[], const uint8_t data[], size_t len, Payload_Encoding_t encoding = PAYLOAD_BASE64);
+
+    /**
+     * @brief Processes input like executeCallback() and reports the result of BeginPublish().
+     *
+     * @param result Receives the result once the publish has finished; AT_TIMEOUT if no final result
+     * code came within GetCommandTimeout(CMD_MQTTPUB).
+     * @return true once, when the publish has finished; false while it is outstanding or if none was begun.
+     */
+    bool PollPublish(AT_Result_t *result);
+
+    /**
+     * @brief Sets how long a redelivered +MQTTPUBLISH is suppressed, 0 (the default) delivers every one.
+     *
+     * A redelivery is a message with the same packet id, topic and payload as one of the last
+     * MQTT_DEDUP_SIZE deliveries within the window, e.g. a QoS 1 message sent again because its
+     * PUBACK was lost. A new publish gets a new packet id and is always delivered, even with the same
+     * content. Messages without a packet id (id 0, QoS 0) are never dropped.
+     */
+    void SetMqttDedupWindow(unsigned long window_ms);
+
+    /**
+     * @brief +MQTTPUBLISH messages dropped as duplicates.
+     */
+    uint32_t GetMqttDuplicates();
+
+    /**
+     * @brief Queues a publish and sends it when the signal is good or its deadline passes.
+     *
+     * Held publishes are sent from executeCallback(), one per call, oldest deadline first. Sending starts
+     * when the last +CSQ rssi reaches SetPublishThreshold(), when a deadline passes or when an urgent
+     * publish is queued, and then continues until the queue is empty so the radio is used in one burst.
+     * The rssi comes from BeginSignalMonitor(); without it only deadlines and urgent publishes trigger a send.
+     * A failed publish is retried after MQTT_QUEUE_RETRY_DELAY_MS, up to MQTT_QUEUE_RETRIES attempts.
+     * Each publish ends with EVENT_MQTT_SENT (param1 = queue id, error = AT_Status_t of the last attempt).
+     *
+     * @param topic The topic, at most MQTT_QUEUE_TOPIC_SIZE - 1 bytes.
+     * @param msg The message, at most MQTT_QUEUE_PAYLOAD_SIZE - 1 bytes.
+     * @param urgent true to send on the next executeCallback() regardless of signal.
+     * @param max_delay_ms Longest time a non-urgent publish is held.
+     * @return Queue id of the publish, or -1 if the queue is full or the message too long.
+     */
+    int QueuePublish(const char topic[], const char msg[], bool urgent = false, unsigned long max_delay_ms = MQTT_QUEUE_MAX_DELAY_MS);
+
+    /**
+     * @brief Sets the +CSQ rssi (0-31) from which held publishes are sent, MQTT_QUEUE_RSSI_MIN by default.
      */
-    bool PublishToTopic(const char topic[], const char msg[]);
+    void SetPublishThreshold(uint8_t rssi);
 
+    /**
+     * @brief Number of publishes waiting in the queue.
+     */
+    uint8_t GetPublishQueueCount();
+
+    /**
+     * @brief Sends every held publish now, regardless of signal.
+     */
+    void FlushPublishQueue();
+#endif
+
+#ifndef A9G_NO_HTTP
+    /*###############################################*/
+    /*********************  HTTP  ********************/
+    /*###############################################*/
 
+    /**
+     * @brief Fetches a URL with AT+HTTPGET and streams the response body.
+     *
+     * Blocks until the body has arrived. The status line and headers are parsed as they come in and the
+     * body goes to the Print piece by piece straight from the receive buffer, so a response of any size
+     * needs no more memory than RX_BUFFER_SIZE. Chunked bodies are decoded. Without Content-Length the
+     * body ends after HTTP_IDLE_TIMEOUT_MS of silence and response->complete stays false. If the Print
+     * takes fewer bytes than offered the transfer is abandoned and the rest of the body is discarded.
+     * https URLs are passed to the module as they are and need firmware that supports them.
+     *
+     * @param url The URL.
+     * @param body Receives the body, nullptr to discard it.
+     * @param response Optional, receives status, length and completion.
+     * @return The AT result; the module's final result code once a status line arrived, OK if it sent none.
+     */
+    AT_Result_t HTTPGet(const char url[], Print *body, HTTP_Response_t *response = nullptr);
+
+    /**
+     * @brief Posts to a URL with AT+HTTPPOST and streams the response body like HTTPGet().
+     *
+     * The request body is read from the Stream until readBytes() returns 0 and travels inside a quoted
+     * AT parameter. A body longer than HTTP_POST_MAX_SIZE or containing '"', CR or LF is refused with
+     * AT_ERROR before anything is sent.
+     *
+     * @param url The URL.
+     * @param content_type The Content-Type of the request body.
+     * @param request The request body, e.g. a File, or nullptr for an empty body.
+     * @param body Receives the response body, nullptr to discard it.
+     * @param response Optional, receives status, length and completion.
+     * @return The AT result; the module's final result code once a status line arrived, OK if it sent none.
+     */
+    AT_Result_t HTTPPost(const char url[], const char content_type[], Stream *request, Print *body, HTTP_Response_t *response = nullptr);
+#endif
 
+#ifndef A9G_NO_SMS
     /*###############################################*/
     /*********************  SMS  *********************/
     /*###############################################*/
@@ -297,17 +1026,22 @@ public:
     /**
      * @brief Activates the Terminal Equipment (TE) to receive unsolicited result codes.
      *
-     * @return true if activation is successful, false otherwise.
+     * @return The result of AT+CNMI; error holds the +CMS ERROR code if the module refused it.
      */
-    bool ActivateTE();
+    AT_Result_t ActivateTE();
 
     /**
-     * @brief Sets the format for reading messages.
+     * @brief Sets the format for reading and sending messages.
+     *
+     * In PDU mode messages are packed as GSM-7 (160 chars) or UCS-2 (70 chars, any Unicode text),
+     * long messages are sent as concatenated SMS, and received segments are reassembled before
+     * EVENT_NEW_SMS_RECEIVED fires with the full text in event->sms_text.
      *
      * @param mode Set to true for text mode, false for PDU mode.
-     * @return true if the command is successful, false otherwise.
+     * @return The result of AT+CMGF. The mode only changes on AT_OK; otherwise error holds the
+     *         +CMS ERROR code.
      */
-    bool SetFormatReading(bool mode); // 1 for txt, 0 for pud format. i don't know what is pud format.
+    AT_Result_t SetFormatReading(bool mode);
     
     /*
         Drubo: AT+CPMS=\"ME\",\"ME\",\"ME\".  :::
@@ -327,9 +1061,9 @@ public:
         "ME": This stands for the phone's memory, where messages are stored on the device itself.
         "MT": This is the combined memory of both the SIM card and the phone's memory.
     *
-    * @return true if the command is successful, false otherwise.
+    * @return The result of AT+CPMS: status, the +CMS ERROR code in error and latency_ms.
     */
-    bool SetMessageStorageUnit();
+    AT_Result_t SetMessageStorageUnit();
 
     /**
      * @brief   AT+CPBS?
@@ -352,6 +1086,8 @@ public:
      * @brief Reads a specific SMS message from the GSM module.
      *
      * This function sends the AT+CMGR command followed by the index of the message to be read.
+     * Waits for an SMS send in progress to finish first. Messages announced by +CMTI are read
+     * this way from executeCallback() once no send is in progress.
      *
      * @param index The index or location of the message to be read.
      *
@@ -371,18 +1107,131 @@ public:
      * @brief Sends an SMS message to a specified phone number.
      *
      * This function sends the AT+CMGS command followed by the destination phone number and the message content.
+     * The body is written as soon as the module's '>' prompt arrives, and the call returns once
+     * "+CMGS: <mr>" or "+CMS ERROR" is received (or SMS_SEND_TIMEOUT_MS expires).
      *
      * @param number The destination phone number in string format.
      * @param message The content of the SMS message.
+     * @param reference Optional, receives the message reference <mr> on success.
      *
      * @return true if the message was sent successfully, false otherwise.
      *
      */
-    bool bSendMessage(const char number[], const char message[]);
+    bool bSendMessage(const char number[], const char message[], int *reference = nullptr);
+
+    /**
+     * @brief Starts sending an SMS message without blocking.
+     *
+     * The message is copied, so the caller's buffer may be reused right away. executeCallback() writes
+     * the body when the '>' prompt arrives and completes the send on "+CMGS: <mr>" (EVENT_CMGS, param1 = <mr>)
+     * or "+CMS ERROR" (EVENT_CMS). Poll GetSMSSendState() for the result. In PDU mode each segment of a
+     * concatenated message is sent in turn and the reference of the last one is kept.
+     * Ignored if another send is still in progress.
+     *
+     * @param number The destination phone number in string format.
+     * @param message The content of the SMS message (UTF-8 in PDU mode), at most SMS_MAX_BODY_SIZE bytes.
+     */
     void vSendMessage(const char number[], const char message[]);
 
+    /**
+     * @brief Queues an SMS for sending without blocking.
+     *
+     * Queued messages are sent one at a time from executeCallback(), no faster than SetMessageInterval().
+     * Sends failing with a transient +CMS ERROR (CONGESTION, SC_BUSY, ...) or timing out are retried; a
+     * message is attempted up to SMS_OUTBOX_RETRIES times in all. Each message ends with EVENT_SMS_SENT (param1 = outbox id, error = 0 or the
+     * CMS error) and, with EnableDeliveryReports(), EVENT_SMS_STATUS_REPORT (param1 = outbox id, error = TP-ST).
+     * Recipients of the same text share one body buffer, so fanning an alert out to many numbers is cheap.
+     * The message format (SetFormatReading()) must be set before queueing.
+     *
+     * @param number The destination phone number in string format.
+     * @param message The content of the SMS message, copied into the outbox.
+     * @return Outbox id of the message, or -1 if the outbox is full.
+     */
+    int QueueMessage(const char number[], const char message[]);
+
+    /**
+     * @brief Number of messages still waiting in the outbox, including the one being sent.
+     */
+    uint8_t GetOutboxCount();
+
+    /**
+     * @brief Sets the minimum time between the start of two outbox sends.
+     *
+     * @param interval_ms Interval in milliseconds, SMS_OUTBOX_INTERVAL_MS by default.
+     */
+    void SetMessageInterval(unsigned long interval_ms);
+
+    /**
+     * @brief Requests delivery reports for sent messages and routes them as +CDS.
+     *
+     * Reports are matched to the message reference returned by +CMGS and delivered as EVENT_SMS_STATUS_REPORT.
+     *
+     * @return The result of AT+CNMI, or of AT+CSMP if AT+CNMI succeeded; error holds the +CMS ERROR
+     *         code of the failing command.
+     */
+    AT_Result_t EnableDeliveryReports();
+
+    /**
+     * @brief State of the last SMS send started with bSendMessage() or vSendMessage().
+     */
+    SMS_Send_State_t GetSMSSendState();
+
+    /**
+     * @brief Message reference <mr> of the last successful send, -1 if none.
+     */
+    int GetSMSReference();
+
+    /**
+     * @brief +CMS ERROR code of the last failed send, CMS_ERROR_NONE if none.
+     */
+    int GetSMSError();
+#endif
+
+    /*###############################################*/
+    /*********************  POWER  *******************/
+    /*###############################################*/
+
+    /**
+     * @brief Enables or disables the module's sleep mode (AT+SLEEP).
+     *
+     * In sleep mode the module sleeps whenever its UART is quiet and still reports URCs such as +CMTI or
+     * +MQTTPUBLISH. Before a command is written after SLEEP_WAKE_IDLE_MS of silence, a wake byte is sent
+     * and the write waits SLEEP_WAKE_DELAY_MS, so callers do not need to wake the module themselves.
+     *
+     * @param enable true to let the module sleep, false to keep it awake.
+     * @return The result of AT+SLEEP.
+     */
+    AT_Result_t SetSleepMode(bool enable);
+
+    /**
+     * @brief Enables or disables RTS/CTS flow control on the module (AT+IFC) and the host UART.
+     *
+     * The module is switched first, then the transport. An A9G_UartTransport started with RTS and CTS
+     * pins is switched by the library; with GSM::init(Stream *) the port must be set up by the sketch
+     * before calling this (e.g. HardwareSerial::setPins() and setHwFlowCtrlMode() on ESP32), otherwise
+     * the module waits for an RTS that never comes. Receive overruns are counted in
+     * Metrics_t::rx_overruns when the transport can detect them.
+     *
+     * @param enable true for RTS/CTS in both directions, false for none.
+     * @return The result of AT+IFC.
+     */
+    AT_Result_t SetFlowControl(bool enable);
 
+    /**
+     * @brief Checks whether the MCU can sleep without losing work.
+     *
+     * @return false while a line is partly received, an SMS send, queued or in progress, is pending or
+     *         a message announced by +CMTI is still to be read.
+     */
+    bool bIsIdle();
 
+    /**
+     * @brief Call after the MCU wakes from light sleep, before executeCallback().
+     *
+     * The UART byte that wakes the MCU is usually lost. URCs start with CR LF so normally nothing of value
+     * goes missing; if the leading '+' was lost as well the first line is still parsed as a term.
+     */
+    void ResumeAfterSleep();
 
     /*###############################################*/
     /*********************  TCP/IP *******************/
@@ -0,0 +1,163 @@
+/*!
+ * @file A9G_Compress.cpp
+ *
+ * Small LZSS compressor for telemetry payloads sent over the A9/A9G.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Compress.h"
+
+size_t compressFrame(const uint8_t in[], size_t len, uint8_t out[], size_t size)
+{
+    size_t o = 0;
+    if (size < 2)
+    {
+        return 0;
+    }
+    out[o++] = COMPRESS_MAGIC;
+    out[o++] = COMPRESS_FLAG_LZSS;
+    size_t value = len;
+    do
+    {
+        if (o >= size)
+        {
+            return 0;
+        }
+        out[o++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0x00);
+        value >>= 7;
+    } while (value);
+
+    size_t control = 0;
+    uint8_t bit = 8;
+    size_t window = COMPRESS_WINDOW < COMPRESS_MAX_DISTANCE ? COMPRESS_WINDOW : COMPRESS_MAX_DISTANCE;
+    for (size_t i = 0; i < len;)
+    {
+        if (bit == 8)
+        {
+            if (o >= size)
+            {
+                return 0;
+            }
+            control = o;
+            out[o++] = 0;
+            bit = 0;
+        }
+
+        // Longest match, nearest first so equal lengths get the shorter distance.
+        size_t best_len = 0;
+        size_t best_dist = 0;
+        size_t max_len = len - i < COMPRESS_MAX_MATCH ? len - i : COMPRESS_MAX_MATCH;
+        size_t start = i > window ? i - window : 0;
+        for (size_t j = i; j-- > start && best_len < max_len;)
+        {
+            if (in[j] != in[i] || in[j + best_len] != in[i + best_len])
+            {
+                continue;
+            }
+            size_t n = 1;
+            while (n < max_len && in[j + n] == in[i + n])
+            {
+                n++;
+            }
+            if (n > best_len)
+            {
+                best_len = n;
+                best_dist = i - j;
+            }
+        }
+
+        if (best_len >= COMPRESS_MIN_MATCH)
+        {
+            if (o + 2 > size)
+            {
+                return 0;
+            }
+            out[o++] = (best_dist - 1) & 0xFF;
+            out[o++] = ((best_dist - 1) >> 8) << 4 | (best_len - COMPRESS_MIN_MATCH);
+            i += best_len;
+        }
+        else
+        {
+            if (o >= size)
+            {
+                return 0;
+            }
+            out[control] |= 1 << bit;
+            out[o++] = in[i++];
+        }
+        bit++;
+    }
+    return o;
+}
+
+size_t decompressFrame(const uint8_t in[], size_t len, uint8_t out[], size_t size)
+{
+    if (len < 3 || in[0] != COMPRESS_MAGIC || in[1] != COMPRESS_FLAG_LZSS)
+    {
+        return 0;
+    }
+    size_t i = 2;
+    size_t total = 0;
+    for (uint8_t shift = 0;; shift += 7)
+    {
+        if (i >= len || shift > 28)
+        {
+            return 0;
+        }
+        total |= (size_t)(in[i] & 0x7F) << shift;
+        if (!(in[i++] & 0x80))
+        {
+            break;
+        }
+    }
+    if (total > size)
+    {
+        return 0;
+    }
+
+    size_t o = 0;
+    uint8_t control = 0;
+    uint8_t bit = 8;
+    while (o < total)
+    {
+        if (bit == 8)
+        {
+            if (i >= len)
+            {
+                return 0;
+            }
+            control = in[i++];
+            bit = 0;
+        }
+        if (control & (1 << bit))
+        {
+            if (i >= len)
+            {
+                return 0;
+            }
+            out[o++] = in[i++];
+        }
+        else
+        {
+            if (i + 2 > len)
+            {
+                return 0;
+            }
+            size_t dist = (in[i] | (in[i + 1] >> 4) << 8) + 1;
+            size_t n = (in[i + 1] & 0x0F) + COMPRESS_MIN_MATCH;
+            i += 2;
+            if (dist > o || o + n > total)
+            {
+                return 0;
+            }
+            for (; n; n--, o++)
+            {
+                out[o] = out[o - dist];
+            }
+        }
+        bit++;
+    }
+    return total;
+}
@@ -0,0 +1,71 @@
+/*!
+ * @file A9G_Compress.h
+ *
+ * Small LZSS compressor for telemetry payloads sent over the A9/A9G.
+ *
+ * A frame is:
+ *
+ *   magic    1 byte   COMPRESS_MAGIC
+ *   flags    1 byte   COMPRESS_FLAG_LZSS, other bits reserved (0)
+ *   length   varint   uncompressed length (unsigned LEB128)
+ *   data              LZSS stream
+ *
+ * The stream is a sequence of groups: a control byte whose bits, LSB first, describe the next eight
+ * items. A 1 bit is one literal byte. A 0 bit is a two byte match: the first byte holds the low 8
+ * bits of (distance - 1), the second the high 4 bits of (distance - 1) in its upper nibble and
+ * (length - COMPRESS_MIN_MATCH) in its lower nibble. Distances go up to 4096 bytes back and lengths
+ * from 3 to 18 bytes. The stream ends when length bytes were produced.
+ *
+ * The compressor searches the input itself instead of keeping hash tables, so besides the output
+ * buffer it needs no RAM; the search goes COMPRESS_WINDOW bytes back to bound the time spent.
+ * extras/compress/a9g_decompress.py decodes frames on the backend.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_COMPRESS_H
+#define A9G_COMPRESS_H
+
+#include <Arduino.h>
+
+#define COMPRESS_MAGIC 0xC5
+#define COMPRESS_FLAG_LZSS 0x01
+#define COMPRESS_MIN_MATCH 3
+#define COMPRESS_MAX_MATCH 18
+#define COMPRESS_MAX_DISTANCE 4096
+#ifndef COMPRESS_WINDOW
+#define COMPRESS_WINDOW 1024                    // bytes searched back for a match, at most COMPRESS_MAX_DISTANCE
+#endif
+
+/**
+ * @brief Worst case frame size for an input of len bytes.
+ */
+inline size_t compressBound(size_t len)
+{
+    return len + (len + 7) / 8 + 7;
+}
+
+/**
+ * @brief Compresses a buffer into a frame.
+ *
+ * @param in Input data.
+ * @param len Length of the input.
+ * @param out Output buffer.
+ * @param size Size of the output buffer, compressBound(len) is always enough.
+ * @return Length of the frame, 0 if it does not fit.
+ */
+size_t compressFrame(const uint8_t in[], size_t len, uint8_t out[], size_t size);
+
+/**
+ * @brief Decompresses a frame.
+ *
+ * @param in The frame.
+ * @param len Length of the frame.
+ * @param out Output buffer.
+ * @param size Size of the output buffer.
+ * @return Uncompressed length, 0 if the frame is invalid or does not fit.
+ */
+size_t decompressFrame(const uint8_t in[], size_t len, uint8_t out[], size_t size);
+
+#endif
@@ -0,0 +1,245 @@
+/*!
+ * @file A9G_Error.cpp
+ *
+ * +CME ERROR / +CMS ERROR code to name lookup.
+ *
+ * Each table is sorted by code and kept in flash (PROGMEM), names are looked up with a binary search.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Error.h"
+
+#ifndef A9G_NO_ERROR_NAMES
+
+// Entries must stay sorted by code.
+#define CME_ERROR_NAMES(X) \
+    X(PHONE_FAILURE, "PHONE_FAILURE") \
+    X(NO_CONNECT_PHONE, "NO_CONNECT_PHONE") \
+    X(PHONE_ADAPTER_LINK_RESERVED, "PHONE_ADAPTER_LINK_RESERVED") \
+    X(OPERATION_NOT_ALLOWED, "OPERATION_NOT_ALLOWED") \
+    X(OPERATION_NOT_SUPPORTED, "OPERATION_NOT_SUPPORTED") \
+    X(PHSIM_PIN_REQUIRED, "PHSIM_PIN_REQUIRED") \
+    X(PHFSIM_PIN_REQUIRED, "PHFSIM_PIN_REQUIRED") \
+    X(PHFSIM_PUK_REQUIRED, "PHFSIM_PUK_REQUIRED") \
+    X(SIM_NOT_INSERTED, "SIM_NOT_INSERTED") \
+    X(SIM_PIN_REQUIRED, "SIM_PIN_REQUIRED") \
+    X(SIM_PUK_REQUIRED, "SIM_PUK_REQUIRED") \
+    X(SIM_FAILURE, "SIM_FAILURE") \
+    X(SIM_BUSY, "SIM_BUSY") \
+    X(SIM_WRONG, "SIM_WRONG") \
+    X(INCORRECT_PASSWORD, "INCORRECT_PASSWORD") \
+    X(SIM_PIN2_REQUIRED, "SIM_PIN2_REQUIRED") \
+    X(SIM_PUK2_REQUIRED, "SIM_PUK2_REQUIRED") \
+    X(MEMORY_FULL, "MEMORY_FULL") \
+    X(INVALID_INDEX, "INVALID_INDEX") \
+    X(NOT_FOUND, "NOT_FOUND") \
+    X(MEMORY_FAILURE, "MEMORY_FAILURE") \
+    X(TEXT_LONG, "TEXT_LONG") \
+    X(INVALID_CHAR_INTEXT, "INVALID_CHAR_INTEXT") \
+    X(DAIL_STR_LONG, "DAIL_STR_LONG") \
+    X(INVALID_CHAR_INDIAL, "INVALID_CHAR_INDIAL") \
+    X(NO_NET_SERVICE, "NO_NET_SERVICE") \
+    X(NETWORK_TIMOUT, "NETWORK_TIMOUT") \
+    X(NOT_ALLOW_EMERGENCY, "NOT_ALLOW_EMERGENCY") \
+    X(NET_PER_PIN_REQUIRED, "NET_PER_PIN_REQUIRED") \
+    X(NET_PER_PUK_REQUIRED, "NET_PER_PUK_REQUIRED") \
+    X(NET_SUB_PER_PIN_REQ, "NET_SUB_PER_PIN_REQ") \
+    X(NET_SUB_PER_PUK_REQ, "NET_SUB_PER_PUK_REQ") \
+    X(SERVICE_PROV_PER_PIN_REQ, "SERVICE_PROV_PER_PIN_REQ") \
+    X(SERVICE_PROV_PER_PUK_REQ, "SERVICE_PROV_PER_PUK_REQ") \
+    X(CORPORATE_PER_PIN_REQ, "CORPORATE_PER_PIN_REQ") \
+    X(CORPORATE_PER_PUK_REQ, "CORPORATE_PER_PUK_REQ") \
+    X(PHSIM_PBK_REQUIRED, "PHSIM_PBK_REQUIRED") \
+    X(EXE_NOT_SURPORT, "EXE_NOT_SURPORT") \
+    X(EXE_FAIL, "EXE_FAIL") \
+    X(NO_MEMORY, "NO_MEMORY") \
+    X(OPTION_NOT_SURPORT, "OPTION_NOT_SURPORT") \
+    X(PARAM_INVALID, "PARAM_INVALID") \
+    X(EXT_REG_NOT_EXIT, "EXT_REG_NOT_EXIT") \
+    X(EXT_SMS_NOT_EXIT, "EXT_SMS_NOT_EXIT") \
+    X(EXT_PBK_NOT_EXIT, "EXT_PBK_NOT_EXIT") \
+    X(EXT_FFS_NOT_EXIT, "EXT_FFS_NOT_EXIT") \
+    X(INVALID_COMMAND_LINE, "INVALID_COMMAND_LINE") \
+    X(GPRS_ILLEGAL_MS_3, "GPRS_ILLEGAL_MS_3") \
+    X(GPRS_ILLEGAL_MS_6, "GPRS_ILLEGAL_MS_6") \
+    X(GPRS_SVR_NOT_ALLOWED, "GPRS_SVR_NOT_ALLOWED") \
+    X(GPRS_PLMN_NOT_ALLOWED, "GPRS_PLMN_NOT_ALLOWED") \
+    X(GPRS_LOCATION_AREA_NOT_ALLOWED, "GPRS_LOCATION_AREA_NOT_ALLOWED") \
+    X(GPRS_ROAMING_NOT_ALLOWED, "GPRS_ROAMING_NOT_ALLOWED") \
+    X(GPRS_OPTION_NOT_SUPPORTED, "GPRS_OPTION_NOT_SUPPORTED") \
+    X(GPRS_OPTION_NOT_SUBSCRIBED, "GPRS_OPTION_NOT_SUBSCRIBED") \
+    X(GPRS_OPTION_TEMP_ORDER_OUT, "GPRS_OPTION_TEMP_ORDER_OUT") \
+    X(GPRS_UNSPECIFIED_GPRS_ERROR, "GPRS_UNSPECIFIED_GPRS_ERROR") \
+    X(GPRS_PDP_AUTHENTICATION_FAILURE, "GPRS_PDP_AUTHENTICATION_FAILURE") \
+    X(GPRS_INVALID_MOBILE_CLASS, "GPRS_INVALID_MOBILE_CLASS") \
+    X(SIM_VERIFY_FAIL, "SIM_VERIFY_FAIL") \
+    X(SIM_UNBLOCK_FAIL, "SIM_UNBLOCK_FAIL") \
+    X(SIM_CONDITION_NO_FULLFILLED, "SIM_CONDITION_NO_FULLFILLED") \
+    X(SIM_UNBLOCK_FAIL_NO_LEFT, "SIM_UNBLOCK_FAIL_NO_LEFT") \
+    X(SIM_VERIFY_FAIL_NO_LEFT, "SIM_VERIFY_FAIL_NO_LEFT") \
+    X(SIM_INVALID_PARAMETER, "SIM_INVALID_PARAMETER") \
+    X(SIM_UNKNOW_COMMAND, "SIM_UNKNOW_COMMAND") \
+    X(SIM_WRONG_CLASS, "SIM_WRONG_CLASS") \
+    X(SIM_TECHNICAL_PROBLEM, "SIM_TECHNICAL_PROBLEM") \
+    X(SIM_CHV_NEED_UNBLOCK, "SIM_CHV_NEED_UNBLOCK") \
+    X(SIM_NOEF_SELECTED, "SIM_NOEF_SELECTED") \
+    X(SIM_FILE_UNMATCH_COMMAND, "SIM_FILE_UNMATCH_COMMAND") \
+    X(SIM_CONTRADICTION_CHV, "SIM_CONTRADICTION_CHV") \
+    X(SIM_CONTRADICTION_INVALIDATION, "SIM_CONTRADICTION_INVALIDATION") \
+    X(SIM_MAXVALUE_REACHED, "SIM_MAXVALUE_REACHED") \
+    X(SIM_PATTERN_NOT_FOUND, "SIM_PATTERN_NOT_FOUND") \
+    X(SIM_FILEID_NOT_FOUND, "SIM_FILEID_NOT_FOUND") \
+    X(SIM_STK_BUSY, "SIM_STK_BUSY") \
+    X(SIM_UNKNOW, "SIM_UNKNOW") \
+    X(SIM_PROFILE_ERROR, "SIM_PROFILE_ERROR")
+
+#define CMS_ERROR_NAMES(X) \
+    X(UNASSIGNED_NUM, "UNASSIGNED_NUM") \
+    X(OPER_DETERM_BARR, "OPER_DETERM_BARR") \
+    X(CALL_BARRED, "CALL_BARRED") \
+    X(SM_TRANS_REJE, "SM_TRANS_REJE") \
+    X(DEST_OOS, "DEST_OOS") \
+    X(UNINDENT_SUB, "UNINDENT_SUB") \
+    X(FACILIT_REJE, "FACILIT_REJE") \
+    X(UNKONWN_SUB, "UNKONWN_SUB") \
+    X(NW_OOO, "NW_OOO") \
+    X(TMEP_FAIL, "TMEP_FAIL") \
+    X(CONGESTION, "CONGESTION") \
+    X(RES_UNAVAILABLE, "RES_UNAVAILABLE") \
+    X(REQ_FAC_NOT_SUB, "REQ_FAC_NOT_SUB") \
+    X(RFQ_FAC_NOT_IMP, "RFQ_FAC_NOT_IMP") \
+    X(INVALID_SM_TRV, "INVALID_SM_TRV") \
+    X(INVALID_MSG, "INVALID_MSG") \
+    X(INVALID_MAND_INFO, "INVALID_MAND_INFO") \
+    X(MSG_TYPE_ERROR, "MSG_TYPE_ERROR") \
+    X(MSG_NOT_COMP, "MSG_NOT_COMP") \
+    X(INFO_ELEMENT_ERROR, "INFO_ELEMENT_ERROR") \
+    X(PROT_ERROR, "PROT_ERROR") \
+    X(IW_UNSPEC, "IW_UNSPEC") \
+    X(TEL_IW_NOT_SUPP, "TEL_IW_NOT_SUPP") \
+    X(SMS_TYPE0_NOT_SUPP, "SMS_TYPE0_NOT_SUPP") \
+    X(CANNOT_REP_SMS, "CANNOT_REP_SMS") \
+    X(UNSPEC_TP_ERROR, "UNSPEC_TP_ERROR") \
+    X(DCS_NOT_SUPP, "DCS_NOT_SUPP") \
+    X(MSG_CLASS_NOT_SUPP, "MSG_CLASS_NOT_SUPP") \
+    X(UNSPEC_TD_ERROR, "UNSPEC_TD_ERROR") \
+    X(CMD_CANNOT_ACT, "CMD_CANNOT_ACT") \
+    X(CMD_UNSUPP, "CMD_UNSUPP") \
+    X(UNSPEC_TC_ERROR, "UNSPEC_TC_ERROR") \
+    X(TPDU_NOT_SUPP, "TPDU_NOT_SUPP") \
+    X(SC_BUSY, "SC_BUSY") \
+    X(NO_SC_SUB, "NO_SC_SUB") \
+    X(SC_SYS_FAIL, "SC_SYS_FAIL") \
+    X(INVALID_SME_ADDR, "INVALID_SME_ADDR") \
+    X(DEST_SME_BARR, "DEST_SME_BARR") \
+    X(SM_RD_SM, "SM_RD_SM") \
+    X(TP_VPF_NOT_SUPP, "TP_VPF_NOT_SUPP") \
+    X(TP_VP_NOT_SUPP, "TP_VP_NOT_SUPP") \
+    X(D0_SIM_SMS_STO_FULL, "D0_SIM_SMS_STO_FULL") \
+    X(NO_SMS_STO_IN_SIM, "NO_SMS_STO_IN_SIM") \
+    X(ERR_IN_MS, "ERR_IN_MS") \
+    X(MEM_CAP_EXCCEEDED, "MEM_CAP_EXCCEEDED") \
+    X(SIM_APP_TK_BUSY, "SIM_APP_TK_BUSY") \
+    X(SIM_DATA_DL_ERROR, "SIM_DATA_DL_ERROR") \
+    X(UNSPEC_ERRO_CAUSE, "UNSPEC_ERRO_CAUSE") \
+    X(ME_FAIL, "ME_FAIL") \
+    X(SMS_SERVIEC_RESERVED, "SMS_SERVIEC_RESERVED") \
+    X(OPER_NOT_ALLOWED, "OPER_NOT_ALLOWED") \
+    X(OPER_NOT_SUPP, "OPER_NOT_SUPP") \
+    X(INVALID_PDU_PARAM, "INVALID_PDU_PARAM") \
+    X(INVALID_TXT_PARAM, "INVALID_TXT_PARAM") \
+    X(SIM_NOT_INSERT, "SIM_NOT_INSERT") \
+    X(CMS_SIM_PIN_REQUIRED, "SIM_PIN_REQUIRED") \
+    X(PH_SIM_PIN_REQUIRED, "PH_SIM_PIN_REQUIRED") \
+    X(SIM_FAIL, "SIM_FAIL") \
+    X(CMS_SIM_BUSY, "SIM_BUSY") \
+    X(CMS_SIM_WRONG, "SIM_WRONG") \
+    X(CMS_SIM_PUK_REQUIRED, "SIM_PUK_REQUIRED") \
+    X(CMS_SIM_PIN2_REQUIRED, "SIM_PIN2_REQUIRED") \
+    X(CMS_SIM_PUK2_REQUIRED, "SIM_PUK2_REQUIRED") \
+    X(MEM_FAIL, "MEM_FAIL") \
+    X(INVALID_MEM_INDEX, "INVALID_MEM_INDEX") \
+    X(MEM_FULL, "MEM_FULL") \
+    X(SCA_ADDR_UNKNOWN, "SCA_ADDR_UNKNOWN") \
+    X(NO_NW_SERVICE, "NO_NW_SERVICE") \
+    X(NW_TIMEOUT, "NW_TIMEOUT") \
+    X(NO_CNMA_ACK_EXPECTED, "NO_CNMA_ACK_EXPECTED") \
+    X(UNKNOWN_ERROR, "UNKNOWN_ERROR") \
+    X(USER_ABORT, "USER_ABORT") \
+    X(UNABLE_TO_STORE, "UNABLE_TO_STORE") \
+    X(INVALID_STATUS, "INVALID_STATUS") \
+    X(INVALID_ADDR_CHAR, "INVALID_ADDR_CHAR") \
+    X(INVALID_LEN, "INVALID_LEN") \
+    X(INVALID_PDU_CHAR, "INVALID_PDU_CHAR") \
+    X(INVALID_PARA, "INVALID_PARA") \
+    X(INVALID_LEN_OR_CHAR, "INVALID_LEN_OR_CHAR") \
+    X(INVALID_TXT_CHAR, "INVALID_TXT_CHAR") \
+    X(TIMER_EXPIRED, "TIMER_EXPIRED")
+
+typedef struct Error_Name_t
+{
+    uint16_t code;
+    const char *name;
+} Error_Name_t;
+
+#define ERROR_NAME_STRING(prefix, code, text) static const char prefix##code[] PROGMEM = text;
+#define CME_NAME_STRING(code, text) ERROR_NAME_STRING(_cme_, code, text)
+#define CMS_NAME_STRING(code, text) ERROR_NAME_STRING(_cms_, code, text)
+#define CME_NAME_ENTRY(code, text) {code, _cme_##code},
+#define CMS_NAME_ENTRY(code, text) {code, _cms_##code},
+
+CME_ERROR_NAMES(CME_NAME_STRING)
+CMS_ERROR_NAMES(CMS_NAME_STRING)
+
+static const Error_Name_t _cme_names[] PROGMEM = {CME_ERROR_NAMES(CME_NAME_ENTRY)};
+static const Error_Name_t _cms_names[] PROGMEM = {CMS_ERROR_NAMES(CMS_NAME_ENTRY)};
+
+static const char *_errorName(const Error_Name_t table[], int count, int code)
+{
+    int low = 0;
+    int high = count - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        int mid_code = pgm_read_word(&table[mid].code);
+        if (mid_code == code)
+        {
+            return (const char *)pgm_read_ptr(&table[mid].name);
+        }
+        if (mid_code < code)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return nullptr;
+}
+
+const char *cmeErrorName(int code)
+{
+    return _errorName(_cme_names, sizeof(_cme_names) / sizeof(_cme_names[0]), code);
+}
+
+const char *cmsErrorName(int code)
+{
+    return _errorName(_cms_names, sizeof(_cms_names) / sizeof(_cms_names[0]), code);
+}
+
+#else
+
+const char *cmeErrorName(int)
+{
+    return nullptr;
+}
+
+const char *cmsErrorName(int)
+{
+    return nullptr;
+}
+
+#endif
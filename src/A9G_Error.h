@@ -0,0 +1,38 @@
+/*!
+ * @file A9G_Error.h
+ *
+ * +CME ERROR / +CMS ERROR code to name lookup.
+ *
+ * Define A9G_NO_ERROR_NAMES to compile the name tables out; the lookups then always return nullptr.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_ERROR_H
+#define A9G_ERROR_H
+
+#include <Arduino.h>
+#include "A9G_Event.h"
+
+/**
+ * @brief Returns the name of a +CME ERROR code (see CME_Error_t).
+ *
+ * On AVR the name lives in program memory, print it with Serial.print((const __FlashStringHelper *)name).
+ *
+ * @param code The CME error code.
+ * @return The name, or nullptr for unknown codes or when names are compiled out.
+ */
+const char *cmeErrorName(int code);
+
+/**
+ * @brief Returns the name of a +CMS ERROR code (see CMS_Error_t).
+ *
+ * On AVR the name lives in program memory, print it with Serial.print((const __FlashStringHelper *)name).
+ *
+ * @param code The CMS error code.
+ * @return The name, or nullptr for unknown codes or when names are compiled out.
+ */
+const char *cmsErrorName(int code);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef A9G_EVENT_H
 #define A9G_EVENT_H
 
+#include <Arduino.h>
+
 typedef enum Event_ID_t
 {
     // event will be Term List
@@ -23,6 +25,14 @@ typedef enum Event_ID_t
     EVENT_CSQ,
     EVENT_IMEI,
     EVENT_CCID,
+    EVENT_SMS_STATUS_REPORT, // TERM_CDS
+    EVENT_CGDCONT,
+    EVENT_CGACT,
+    EVENT_CPIN,
+    // events below have no term
+    EVENT_SMS_SENT,          // outbox message finished, see GSM::QueueMessage()
+    EVENT_READY,             // readiness changed, param1 = Ready_State_t, see GSM::BeginReadyWait()
+    EVENT_MQTT_SENT,         // queued publish finished, see GSM::QueuePublish()
     EVENT_MAX,
     EVENT_NONE
 } Event_ID_t;
@@ -204,17 +214,191 @@ typedef enum Message_Type_t
     UNREAD_MESSAGE = 2,
     ALL_MESSAGE = 4
 } Message_Type_t;
+
+typedef enum AT_Command_t
+{
+    CMD_AT = 0,
+    CMD_CSQ,
+    CMD_EGMR,
+    CMD_CCID,
+    CMD_CGATT_READ,   // AT+CGATT?
+    CMD_CGATT,        // attach/detach
+    CMD_CGDCONT,
+    CMD_CGACT,
+    CMD_MQTTCONN,
+    CMD_MQTTDISCONN,
+    CMD_MQTTSUB,
+    CMD_MQTTUNSUB,
+    CMD_MQTTPUB,
+    CMD_CNMI,
+    CMD_CMGF,
+    CMD_CPMS,
+    CMD_CSMP,
+    CMD_SLEEP,
+    CMD_CREG_READ,
+    CMD_CGDCONT_READ,
+    CMD_CGACT_READ,
+    CMD_CREG,
+    CMD_HTTPGET,      // time to the response status line
+    CMD_HTTPPOST,
+    CMD_IFC,
+    CMD_MAX
+} AT_Command_t;
+
+typedef enum AT_Status_t
+{
+    AT_OK = 0,
+    AT_ERROR,     // plain "ERROR"
+    AT_CME_ERROR, // "+CME ERROR: <n>", code in error (CME_Error_t)
+    AT_CMS_ERROR, // "+CMS ERROR: <n>", code in error (CMS_Error_t)
+    AT_TIMEOUT    // no final result code before the timeout
+} AT_Status_t;
+
+/**
+ * @brief Outcome of an AT command.
+ *
+ * Converts to true only for AT_OK, so it can be used where a bool was returned before.
+ */
+typedef struct AT_Result_t
+{
+    AT_Status_t status;
+    int error;                  // +CME/+CMS ERROR code, 0 otherwise
+    unsigned long latency_ms;   // time from sending the command to its final result code
+
+    operator bool() const { return status == AT_OK; }
+} AT_Result_t;
+
+typedef enum SMS_Send_State_t
+{
+    SMS_SEND_IDLE = 0,
+    SMS_SEND_WAIT_PROMPT, // AT+CMGS issued, waiting for the '>' prompt
+    SMS_SEND_WAIT_REF,    // body + Ctrl-Z written, waiting for +CMGS: <mr>
+    SMS_SEND_DONE,
+    SMS_SEND_FAILED,      // +CMS ERROR received, see GetSMSError()
+    SMS_SEND_TIMEOUT
+} SMS_Send_State_t;
+
+typedef enum Ready_State_t
+{
+    READY_UNKNOWN = 0,
+    READY_BOOTING,  // waiting for READY, see GSM::BeginReadyWait()
+    READY_OK,       // READY or +CPIN: READY received
+    READY_NO_SIM,   // NO SIM CARD received
+    READY_TIMEOUT   // nothing within the timeout and no power cycles left
+} Ready_State_t;
+
+#define A9G_STATE_MAGIC 0xA9C5
+
+/**
+ * Module state cached by GSM, see GSM::SetStateStore(). Plain data so it can be kept in memory that
+ * survives MCU resets (RTC_NOINIT_ATTR on ESP32) or saved to NVS/EEPROM.
+ */
+typedef struct A9G_State_t
+{
+    uint16_t magic;         // A9G_STATE_MAGIC when the content is valid
+    int8_t creg;            // +CREG <stat>: 1 home, 5 roaming; -1 unknown
+    int8_t attached;        // +CGATT: 1 attached; -1 unknown
+    int8_t pdp_active;      // +CGACT state of context 1; -1 unknown
+    char pdp_type[8];       // +CGDCONT of context 1
+    char apn[40];
+    uint8_t checksum;
+} A9G_State_t;
+
+typedef enum Payload_Encoding_t
+{
+    PAYLOAD_BASE64 = 0, // RFC 4648 with padding, 4 characters per 3 bytes
+    PAYLOAD_HEX         // upper case, 2 characters per byte
+} Payload_Encoding_t;
+
+/**
+ * Outcome of GSM::HTTPGet() and GSM::HTTPPost(). The body itself goes to the caller's Print.
+ */
+typedef struct HTTP_Response_t
+{
+    int status;             // HTTP status code, 0 if no response arrived
+    long content_length;    // Content-Length header, -1 if not sent
+    uint32_t body_len;      // body bytes handed to the Print
+    bool chunked;           // Transfer-Encoding: chunked, decoded before the body is handed out
+    bool complete;          // the whole body arrived and the Print took all of it
+} HTTP_Response_t;
+
+/**
+ * One +CSQ reading with the serving cell at that time, see GSM::BeginSignalMonitor().
+ */
+typedef struct Signal_Sample_t
+{
+    unsigned long time_ms;  // millis() when +CSQ arrived
+    uint32_t ci;            // cell id, 0 if unknown (reported with AT+CREG=2)
+    uint16_t lac;           // location area code, 0 if unknown
+    uint8_t rssi;           // +CSQ <rssi>: 0 (-113 dBm) to 31 (-51 dBm or more), 99 unknown
+    uint8_t ber;            // +CSQ <ber>: 0-7, 99 unknown
+    int8_t creg;            // +CREG <stat>: 1 home, 5 roaming; -1 unknown
+} Signal_Sample_t;
+
+/**
+ * Delivery order of events from GSM::executeCallback(), see GSM::SetEventPriority().
+ */
+typedef enum Event_Priority_t
+{
+    EVENT_PRIORITY_CONTROL = 0, // errors, registration, SIM and MQTT on the control topic
+    EVENT_PRIORITY_NORMAL,      // everything else
+    EVENT_PRIORITY_BULK,        // GPS
+    EVENT_PRIORITY_MAX
+} Event_Priority_t;
+
+/**
+ * What a priority lane does with a new event when it is full.
+ */
+typedef enum Lane_Policy_t
+{
+    LANE_BLOCK = 0,     // nothing is dropped, further lines wait in the RX buffer until the lane has room
+    LANE_DROP_OLDEST,   // the oldest pending events make room, for status where only the latest matters
+    LANE_DROP_NEWEST    // the new event is dropped
+} Lane_Policy_t;
+
+// message, topic and param2 point into the receive buffer and are null terminated. They are valid
+// until the callback returns or calls a GSM method that waits for the module; use eventStringCopy()
+// to keep them longer. Fields an event does not use are empty strings.
 typedef struct A9G_Event_t
 {
     Event_ID_t id;
     int error;
-    char message[100];
-    char topic[50];
-    char number[16];
+    const char *message;
+    uint16_t message_len;
+    const char *topic;
+    uint16_t topic_len;
+    char number[22];        // "+" and up to 20 digits, PDU_MAX_NUMBER_SIZE
     char date_time[25];
     int param1;
-    char param2[30];
+    const char *param2;
+    uint16_t param2_len;
     char param3[50];
+    const char *sms_text;   // EVENT_NEW_SMS_RECEIVED: full text (UTF-8 in PDU mode), same as message
+    uint16_t sms_text_len;
 } A9G_Event_t;
 
+/**
+ * @brief Copies an event string such as event->message so it can be kept after the callback.
+ *
+ * @param out Destination buffer.
+ * @param size Size of the destination buffer.
+ * @param str The string from the event.
+ * @param len Its length, e.g. event->message_len.
+ * @return Number of bytes copied, excluding the null terminator. Less than len if out was too small.
+ */
+inline size_t eventStringCopy(char out[], size_t size, const char str[], uint16_t len)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+    if (len > size - 1)
+    {
+        len = size - 1;
+    }
+    memcpy(out, str, len);
+    out[len] = '\0';
+    return len;
+}
+
 #endif
\ No newline at end of file
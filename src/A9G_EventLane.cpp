@@ -0,0 +1,92 @@
+/*!
+ * @file A9G_EventLane.cpp
+ *
+ * FIFO of pending terms for one event priority.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_EventLane.h"
+
+size_t A9G_EventLane::room()
+{
+    return EVENT_LANE_SIZE - (_end - _start);
+}
+
+bool A9G_EventLane::push(uint8_t term_id, const char data[], size_t len)
+{
+    if (EVENT_LANE_RECORD(len) > EVENT_LANE_SIZE)
+    {
+        dropped++;
+        return false;
+    }
+    if (EVENT_LANE_RECORD(len) > room())
+    {
+        if (policy != LANE_DROP_OLDEST)
+        {
+            dropped++;
+            return false;
+        }
+        while (EVENT_LANE_RECORD(len) > room())
+        {
+            pop();
+            dropped++;
+        }
+    }
+    if (EVENT_LANE_RECORD(len) > EVENT_LANE_SIZE - _end)
+    {
+        memmove(_buffer, _buffer + _start, _end - _start);
+        _end -= _start;
+        _start = 0;
+    }
+
+    uint8_t *record = _buffer + _end;
+    record[0] = term_id;
+    record[1] = len & 0xFF;
+    record[2] = len >> 8;
+    memcpy(record + 3, data, len);
+    record[3 + len] = '\0';
+    _end += EVENT_LANE_RECORD(len);
+    _count++;
+    return true;
+}
+
+char *A9G_EventLane::front(uint8_t *term_id, size_t *len)
+{
+    if (!_count)
+    {
+        return nullptr;
+    }
+    uint8_t *record = _buffer + _start;
+    *term_id = record[0];
+    *len = record[1] | record[2] << 8;
+    return (char *)record + 3;
+}
+
+void A9G_EventLane::pop()
+{
+    if (!_count)
+    {
+        return;
+    }
+    uint8_t *record = _buffer + _start;
+    _start += EVENT_LANE_RECORD(record[1] | record[2] << 8);
+    if (!--_count)
+    {
+        _start = 0;
+        _end = 0;
+    }
+}
+
+uint16_t A9G_EventLane::count()
+{
+    return _count;
+}
+
+void A9G_EventLane::clear()
+{
+    _start = 0;
+    _end = 0;
+    _count = 0;
+}
@@ -0,0 +1,75 @@
+/*!
+ * @file A9G_EventLane.h
+ *
+ * FIFO of pending terms for one event priority, see GSM::SetEventPriority().
+ *
+ * Each record is the term id, the length of its data and the data itself, null terminated, copied
+ * out of the receive buffer so the line can be released before the event is delivered. Records
+ * are kept back to back in one buffer; when the end is reached the live records are moved to the
+ * front. What happens to a record that does not fit is up to the caller's Lane_Policy_t.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_EVENTLANE_H
+#define A9G_EVENTLANE_H
+
+#include <Arduino.h>
+#include "A9G_Event.h"
+#include "A9G_RxBuffer.h"
+
+#ifndef EVENT_LANE_SIZE
+#define EVENT_LANE_SIZE 1024                    // bytes per priority, terms take their data length + 4
+#endif
+#define EVENT_LANE_RECORD(len) ((len) + 4)      // term id, 16 bit length, data, null terminator
+
+#if EVENT_LANE_SIZE < RX_BUFFER_SIZE + 4
+#error "EVENT_LANE_SIZE must hold the longest line, RX_BUFFER_SIZE + 4"
+#endif
+
+class A9G_EventLane
+{
+private:
+    uint8_t _buffer[EVENT_LANE_SIZE];
+    size_t _start = 0;   // first record
+    size_t _end = 0;     // one past the last record
+    uint16_t _count = 0;
+
+public:
+    Lane_Policy_t policy = LANE_BLOCK;
+    uint32_t dropped = 0;   // records dropped by LANE_DROP_OLDEST or LANE_DROP_NEWEST
+
+    /**
+     * @brief Free bytes, counting the space before the first record.
+     */
+    size_t room();
+
+    /**
+     * @brief Appends a record, dropping by policy when it does not fit.
+     *
+     * With LANE_BLOCK the caller must make sure it fits, see room().
+     *
+     * @return false if the record was dropped.
+     */
+    bool push(uint8_t term_id, const char data[], size_t len);
+
+    /**
+     * @brief Oldest record, nullptr if the lane is empty.
+     *
+     * @param term_id Receives the term id.
+     * @param len Receives the length of the data.
+     * @return The data, null terminated and writable until the next push() or pop().
+     */
+    char *front(uint8_t *term_id, size_t *len);
+
+    /**
+     * @brief Drops the oldest record.
+     */
+    void pop();
+
+    uint16_t count();
+    void clear();
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*!
+ * @file A9G_Latency.cpp
+ *
+ * Per-command AT latency tracking for the A9/A9G.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Latency.h"
+
+unsigned long AT_Latency::bucketLimit(uint8_t bucket)
+{
+    return (unsigned long)LATENCY_BUCKET_BASE_MS << bucket;
+}
+
+#ifndef A9G_NO_LATENCY
+AT_Latency::AT_Latency()
+{
+    memset(_stats, 0, sizeof(_stats));
+}
+
+void AT_Latency::record(AT_Command_t cmd, unsigned long latency_ms)
+{
+    if (cmd >= CMD_MAX)
+    {
+        return;
+    }
+    Stats_t *stats = &_stats[cmd];
+
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && latency_ms > bucketLimit(bucket))
+    {
+        bucket++;
+    }
+    if (stats->buckets[bucket] == 0xFF)
+    {
+        for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            stats->buckets[i] /= 2;
+        }
+    }
+    stats->buckets[bucket]++;
+
+    if (stats->samples == 0)
+    {
+        stats->ewma_ms = latency_ms;
+    }
+    else
+    {
+        stats->ewma_ms = (long)stats->ewma_ms + ((long)latency_ms - (long)stats->ewma_ms) / 8;
+    }
+    if (stats->samples < 0xFFFF)
+    {
+        stats->samples++;
+    }
+}
+
+unsigned long AT_Latency::percentile(AT_Command_t cmd, uint8_t pct)
+{
+    if (cmd >= CMD_MAX)
+    {
+        return 0;
+    }
+    Stats_t *stats = &_stats[cmd];
+
+    uint16_t total = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        total += stats->buckets[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint16_t target = ((uint32_t)total * pct + 99) / 100;
+    uint16_t count = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        count += stats->buckets[i];
+        if (count >= target)
+        {
+            return bucketLimit(i);
+        }
+    }
+    return bucketLimit(LATENCY_BUCKETS - 1);
+}
+
+unsigned long AT_Latency::ewma(AT_Command_t cmd)
+{
+    return cmd < CMD_MAX ? _stats[cmd].ewma_ms : 0;
+}
+
+uint16_t AT_Latency::samples(AT_Command_t cmd)
+{
+    return cmd < CMD_MAX ? _stats[cmd].samples : 0;
+}
+
+const uint8_t *AT_Latency::histogram(AT_Command_t cmd)
+{
+    return cmd < CMD_MAX ? _stats[cmd].buckets : nullptr;
+}
+#else
+AT_Latency::AT_Latency()
+{
+}
+
+void AT_Latency::record(AT_Command_t, unsigned long)
+{
+}
+
+unsigned long AT_Latency::percentile(AT_Command_t, uint8_t)
+{
+    return 0;
+}
+
+unsigned long AT_Latency::ewma(AT_Command_t)
+{
+    return 0;
+}
+
+uint16_t AT_Latency::samples(AT_Command_t)
+{
+    return 0;
+}
+
+const uint8_t *AT_Latency::histogram(AT_Command_t)
+{
+    return nullptr;
+}
+#endif
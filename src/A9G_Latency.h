@@ -0,0 +1,81 @@
+/*!
+ * @file A9G_Latency.h
+ *
+ * Per-command AT latency tracking for the A9/A9G.
+ *
+ * Every command type keeps an EWMA of its latency and a small log-scale histogram used as a
+ * percentile sketch. Bucket i counts latencies up to (LATENCY_BUCKET_BASE_MS << i), the last
+ * bucket takes everything above. Counts are halved when one saturates, so old samples fade out.
+ *
+ * Define A9G_NO_LATENCY to compile the statistics out; nothing is recorded and every query returns 0,
+ * so commands keep their default timeouts.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_LATENCY_H
+#define A9G_LATENCY_H
+
+#include <Arduino.h>
+#include "A9G_Event.h"
+
+#define LATENCY_BUCKETS 12
+#define LATENCY_BUCKET_BASE_MS 16
+
+class AT_Latency
+{
+private:
+    typedef struct Stats_t
+    {
+        uint8_t buckets[LATENCY_BUCKETS];
+        uint16_t samples;
+        unsigned long ewma_ms;
+    } Stats_t;
+
+#ifndef A9G_NO_LATENCY
+    Stats_t _stats[CMD_MAX];
+#endif
+
+public:
+    AT_Latency();
+
+    /**
+     * @brief Records one observed latency.
+     *
+     * @param cmd The command type.
+     * @param latency_ms Time from sending the command to its final result code (or the timeout used).
+     */
+    void record(AT_Command_t cmd, unsigned long latency_ms);
+
+    /**
+     * @brief Estimates a latency percentile.
+     *
+     * @param cmd The command type.
+     * @param pct Percentile, 1 to 100.
+     * @return Upper bound of the histogram bucket holding the percentile, 0 without samples.
+     */
+    unsigned long percentile(AT_Command_t cmd, uint8_t pct);
+
+    /**
+     * @brief Exponentially weighted moving average of the latency (alpha = 1/8).
+     */
+    unsigned long ewma(AT_Command_t cmd);
+
+    /**
+     * @brief Number of samples recorded (saturates at 65535).
+     */
+    uint16_t samples(AT_Command_t cmd);
+
+    /**
+     * @brief Upper bound of a histogram bucket in milliseconds.
+     */
+    static unsigned long bucketLimit(uint8_t bucket);
+
+    /**
+     * @brief Raw histogram counts of a command, LATENCY_BUCKETS entries, nullptr if compiled out.
+     */
+    const uint8_t *histogram(AT_Command_t cmd);
+};
+
+#endif
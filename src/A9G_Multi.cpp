@@ -0,0 +1,247 @@
+/*!
+ * @file A9G_Multi.cpp
+ *
+ * Failover and load sharing over several A9/A9G modules.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Multi.h"
+
+#ifndef A9G_NO_MQTT
+int A9G_Multi::add(GSM *gsm)
+{
+    if (_count >= MULTI_MAX_LINKS)
+    {
+        return -1;
+    }
+    _links[_count] = gsm;
+    _latency[_count] = 0;
+    _failures[_count] = 0;
+    _published[_count] = 0;
+    _downMS[_count] = 0;
+    return _count++;
+}
+
+void A9G_Multi::poll()
+{
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        _links[i]->executeCallback();
+    }
+}
+
+void A9G_Multi::_health(uint8_t link, Link_Health_t *health)
+{
+    GSM *gsm = _links[link];
+    if (_downMS[link] && millis() - _downMS[link] >= MULTI_RETRY_MS)
+    {
+        // Back in on probation: the next failure takes it out again.
+        _downMS[link] = 0;
+        _failures[link] = MULTI_MAX_FAILURES - 1;
+    }
+
+    Signal_Sample_t sample;
+    A9G_State_t state;
+    gsm->GetState(&state);
+    health->creg = state.creg;
+    health->rssi = gsm->GetSignal(&sample) ? sample.rssi : 99;
+    health->latency_ms = _latency[link];
+    health->failures = _failures[link];
+    health->published = _published[link];
+
+    Ready_State_t ready = gsm->GetReadyState();
+    bool registered = health->creg < 0 || health->creg == 1 || health->creg == 5;
+    health->usable = !_downMS[link] && registered && ready != READY_BOOTING && ready != READY_NO_SIM && ready != READY_TIMEOUT;
+
+    int rssi = health->rssi == 99 ? MULTI_RSSI_UNKNOWN : health->rssi;
+    health->score = rssi * MULTI_RSSI_WEIGHT - (int)(health->latency_ms / MULTI_LATENCY_DIVISOR) -
+                    health->failures * MULTI_FAILURE_PENALTY + (link == _active ? MULTI_HYSTERESIS : 0);
+}
+
+uint8_t A9G_Multi::_ranked(uint8_t order[])
+{
+    int score[MULTI_MAX_LINKS];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        Link_Health_t health;
+        _health(i, &health);
+        if (!health.usable)
+        {
+            continue;
+        }
+        // Insertion by score, best first.
+        uint8_t j = n++;
+        for (; j > 0 && score[j - 1] < health.score; j--)
+        {
+            score[j] = score[j - 1];
+            order[j] = order[j - 1];
+        }
+        score[j] = health.score;
+        order[j] = i;
+    }
+    return n;
+}
+
+void A9G_Multi::_record(uint8_t link, const AT_Result_t &result)
+{
+    _latency[link] = _latency[link] ? (_latency[link] * 3 + result.latency_ms) / 4 : result.latency_ms;
+    if (result)
+    {
+        _failures[link] = 0;
+        _published[link]++;
+        _active = link;
+        return;
+    }
+    if (++_failures[link] >= MULTI_MAX_FAILURES)
+    {
+        _downMS[link] = millis() | 1; // 0 means in
+    }
+}
+
+AT_Result_t A9G_Multi::publish(const char topic[], const char msg[])
+{
+    AT_Result_t result = {AT_ERROR, 0, 0};
+    uint8_t order[MULTI_MAX_LINKS];
+    uint8_t n = _ranked(order);
+    for (uint8_t i = 0; i < n; i++)
+    {
+        result = _links[order[i]]->PublishToTopic(topic, msg);
+        _record(order[i], result);
+        if (result)
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+bool A9G_Multi::stripe(const char topic[], const uint8_t data[], size_t len, size_t chunk_size, Payload_Encoding_t encoding)
+{
+    if (!chunk_size || !_count)
+    {
+        return false;
+    }
+    size_t total = (len + chunk_size - 1) / chunk_size;
+    char chunk_topic[MULTI_TOPIC_SIZE];
+    int topic_len = snprintf(chunk_topic, sizeof(chunk_topic), "%s/%u/%u", topic, (unsigned)total, (unsigned)total);
+    if (topic_len < 0 || topic_len >= (int)sizeof(chunk_topic))
+    {
+        return false;
+    }
+
+    long inflight[MULTI_MAX_LINKS];
+    size_t retry[MULTI_MAX_LINKS];      // failed chunks, at most one per link
+    uint8_t retries = 0;
+    size_t next = 0;
+    size_t done = 0;
+    unsigned long progress_ms = millis();
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        inflight[i] = -1;
+    }
+
+    while (done < total)
+    {
+        bool busy = false;
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            if (inflight[i] >= 0)
+            {
+                AT_Result_t result;
+                if (!_links[i]->PollPublish(&result))
+                {
+                    busy = true;
+                    continue;
+                }
+                _record(i, result);
+                if (result)
+                {
+                    done++;
+                }
+                else
+                {
+                    // Another round, so a link passed over in this one can take it.
+                    retry[retries++] = inflight[i];
+                    busy = true;
+                }
+                inflight[i] = -1;
+                progress_ms = millis();
+            }
+            else
+            {
+                _links[i]->executeCallback();
+            }
+
+            Link_Health_t health;
+            _health(i, &health);
+            if (!health.usable || (!retries && next >= total))
+            {
+                continue;
+            }
+            bool from_retry = retries > 0;
+            size_t chunk = from_retry ? retry[--retries] : next++;
+            size_t offset = chunk * chunk_size;
+            snprintf(chunk_topic, sizeof(chunk_topic), "%s/%u/%u", topic, (unsigned)chunk, (unsigned)total);
+            if (_links[i]->BeginPublish(chunk_topic, data + offset, len - offset < chunk_size ? len - offset : chunk_size, encoding))
+            {
+                inflight[i] = chunk;
+                progress_ms = millis();
+            }
+            else if (from_retry)
+            {
+                retries++;
+            }
+            else
+            {
+                next--;
+            }
+            // A usable link that is momentarily not idle keeps the upload going.
+            busy = true;
+        }
+        if (!busy || millis() - progress_ms > MULTI_STALL_MS)
+        {
+            // Nothing usable is left, or nothing moved; wait out chunks still in flight so the links stay consistent.
+            for (uint8_t i = 0; i < _count; i++)
+            {
+                AT_Result_t result;
+                while (inflight[i] >= 0 && !_links[i]->PollPublish(&result))
+                {
+                    yield();
+                }
+                if (inflight[i] >= 0)
+                {
+                    _record(i, result);
+                    done += result ? 1 : 0;
+                }
+            }
+            return done == total;
+        }
+        yield();
+    }
+    return true;
+}
+
+int A9G_Multi::best()
+{
+    uint8_t order[MULTI_MAX_LINKS];
+    return _ranked(order) ? order[0] : -1;
+}
+
+int A9G_Multi::active()
+{
+    return _active;
+}
+
+bool A9G_Multi::getHealth(uint8_t link, Link_Health_t *health)
+{
+    if (link >= _count)
+    {
+        return false;
+    }
+    _health(link, health);
+    return true;
+}
+#endif
@@ -0,0 +1,131 @@
+/*!
+ * @file A9G_Multi.h
+ *
+ * Failover and load sharing over several A9/A9G modules, e.g. two carriers on two UARTs.
+ *
+ * Every link is an initialised GSM with its MQTT session up. Each link gets a health score from its
+ * registration and last +CSQ (GSM::BeginSignalMonitor()), the smoothed latency of its publishes and
+ * its recent failures:
+ *
+ *   score = rssi * MULTI_RSSI_WEIGHT - latency_ms / MULTI_LATENCY_DIVISOR - failures * MULTI_FAILURE_PENALTY
+ *
+ * with an unknown rssi counted as MULTI_RSSI_UNKNOWN and MULTI_HYSTERESIS added for the link used last,
+ * so traffic does not flap between two similar links. A link is left out while it is not registered
+ * (+CREG other than 1 or 5, once known), while its module is not ready, and for MULTI_RETRY_MS after
+ * MULTI_MAX_FAILURES failed publishes in a row.
+ *
+ * publish() sends on the best link and tries the others in order of score when it fails. stripe()
+ * splits a large payload into chunks and keeps one chunk in flight on every usable link at once
+ * (GSM::BeginPublish()); a link that finishes sooner takes the next chunk, so the faster carrier
+ * carries more of the upload. Chunk n of N goes to "<topic>/<n>/<N>", n counting from 0.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_MULTI_H
+#define A9G_MULTI_H
+
+#include <Arduino.h>
+#include "A9G.h"
+
+#ifndef MULTI_MAX_LINKS
+#define MULTI_MAX_LINKS 2
+#endif
+#define MULTI_MAX_FAILURES 3                // failed publishes in a row before a link is taken out
+#ifndef MULTI_RETRY_MS
+#define MULTI_RETRY_MS 60000                // time a failed link stays out
+#endif
+#define MULTI_RSSI_WEIGHT 8
+#define MULTI_RSSI_UNKNOWN 10               // rssi assumed before the first +CSQ
+#define MULTI_LATENCY_DIVISOR 64            // 1 score point per 64 ms of publish latency
+#define MULTI_FAILURE_PENALTY 32
+#define MULTI_HYSTERESIS 16
+#define MULTI_TOPIC_SIZE 96                 // longest chunk topic in stripe()
+#define MULTI_STALL_MS 30000                // stripe() gives up when no chunk started or finished for this long
+
+/**
+ * Health of one link, see A9G_Multi::getHealth().
+ */
+typedef struct Link_Health_t
+{
+    bool usable;            // considered by publish() and stripe()
+    int8_t creg;            // +CREG <stat>, -1 unknown
+    uint8_t rssi;           // +CSQ <rssi>, 99 unknown
+    uint32_t latency_ms;    // smoothed publish latency, 0 before the first publish
+    uint8_t failures;       // failed publishes in a row
+    int score;
+    uint32_t published;     // successful publishes
+} Link_Health_t;
+
+#ifndef A9G_NO_MQTT
+class A9G_Multi
+{
+private:
+    GSM *_links[MULTI_MAX_LINKS];
+    uint8_t _count = 0;
+    int8_t _active = -1;
+    uint32_t _latency[MULTI_MAX_LINKS];
+    uint8_t _failures[MULTI_MAX_LINKS];
+    uint32_t _published[MULTI_MAX_LINKS];
+    unsigned long _downMS[MULTI_MAX_LINKS];     // millis() when the link was taken out, 0 if it is in
+
+    void _health(uint8_t link, Link_Health_t *health);
+    uint8_t _ranked(uint8_t order[]);
+    void _record(uint8_t link, const AT_Result_t &result);
+
+public:
+    /**
+     * @brief Adds a link.
+     *
+     * @param gsm An initialised GSM, kept by the caller.
+     * @return Its index, -1 if MULTI_MAX_LINKS are already added.
+     */
+    int add(GSM *gsm);
+
+    /**
+     * @brief Calls executeCallback() on every link. Call it from loop() instead of those.
+     */
+    void poll();
+
+    /**
+     * @brief Publishes on the healthiest link and fails over to the others.
+     *
+     * @return The result of the last attempt, AT_ERROR if no link is usable.
+     */
+    AT_Result_t publish(const char topic[], const char msg[]);
+
+    /**
+     * @brief Publishes a large payload in chunks spread over all usable links. Blocks until done.
+     *
+     * A failed chunk is sent again on the next free link. The upload stops when no link is usable.
+     *
+     * @param topic Base topic, the chunks go to "<topic>/<n>/<N>".
+     * @param data The payload.
+     * @param len Its length.
+     * @param chunk_size Payload bytes per publish, before encoding.
+     * @param encoding Text encoding of each chunk, see GSM::PublishBinary().
+     * @return true if every chunk was published.
+     */
+    bool stripe(const char topic[], const uint8_t data[], size_t len, size_t chunk_size, Payload_Encoding_t encoding = PAYLOAD_BASE64);
+
+    /**
+     * @brief Index of the healthiest usable link, -1 if none is usable.
+     */
+    int best();
+
+    /**
+     * @brief Link of the last successful publish, -1 before the first.
+     */
+    int active();
+
+    /**
+     * @brief Copies the health of a link.
+     *
+     * @return false if there is no such link.
+     */
+    bool getHealth(uint8_t link, Link_Health_t *health);
+};
+#endif
+
+#endif
@@ -0,0 +1,283 @@
+/*!
+ * @file A9G_OTA.cpp
+ *
+ * Firmware download over the A9/A9G into the ESP32 OTA partition.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_OTA.h"
+
+#if defined(ESP32)
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#endif
+
+static const uint32_t _sha256_k[64] PROGMEM = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t _ror(uint32_t x, uint8_t n)
+{
+    return x >> n | x << (32 - n);
+}
+
+static void _sha256Block(SHA256_Context_t *ctx, const uint8_t block[64])
+{
+    uint32_t w[64];
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (uint8_t i = 16; i < 64; i++)
+    {
+        uint32_t s0 = _ror(w[i - 15], 7) ^ _ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = _ror(w[i - 2], 17) ^ _ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (uint8_t i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (_ror(e, 6) ^ _ror(e, 11) ^ _ror(e, 25)) + ((e & f) ^ (~e & g)) + pgm_read_dword(&_sha256_k[i]) + w[i];
+        uint32_t t2 = (_ror(a, 2) ^ _ror(a, 13) ^ _ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha256Begin(SHA256_Context_t *ctx)
+{
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->length = 0;
+}
+
+void sha256Update(SHA256_Context_t *ctx, const uint8_t data[], size_t len)
+{
+    size_t used = ctx->length % 64;
+    ctx->length += len;
+    if (used)
+    {
+        size_t n = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->block + used, data, n);
+        data += n;
+        len -= n;
+        if (used + n < 64)
+        {
+            return;
+        }
+        _sha256Block(ctx, ctx->block);
+    }
+    for (; len >= 64; data += 64, len -= 64)
+    {
+        _sha256Block(ctx, data);
+    }
+    memcpy(ctx->block, data, len);
+}
+
+void sha256Finish(SHA256_Context_t *ctx, uint8_t digest[32])
+{
+    uint64_t bits = ctx->length * 8;
+    size_t used = ctx->length % 64;
+    ctx->block[used++] = 0x80;
+    if (used > 56)
+    {
+        memset(ctx->block + used, 0, 64 - used);
+        _sha256Block(ctx, ctx->block);
+        used = 0;
+    }
+    memset(ctx->block + used, 0, 56 - used);
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        ctx->block[56 + i] = bits >> (56 - i * 8);
+    }
+    _sha256Block(ctx, ctx->block);
+    for (uint8_t i = 0; i < 32; i++)
+    {
+        digest[i] = ctx->state[i / 4] >> (24 - (i % 4) * 8);
+    }
+}
+
+#ifndef A9G_NO_HTTP
+bool A9G_OTA::begin(GSM *gsm, const char url[], uint32_t size, const uint8_t sha256[32], OTA_State_t *state)
+{
+    _status = OTA_IDLE;
+#if defined(ESP32)
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (!partition || size > partition->size)
+    {
+        return false;
+    }
+    _partition = partition;
+    _gsm = gsm;
+    _url = url;
+    _state = state ? state : &_localState;
+    _retries = 0;
+
+    if (_state->magic != OTA_STATE_MAGIC || _state->partition != partition->address || _state->size != size ||
+        memcmp(_state->sha256, sha256, 32) || _state->offset > size || _state->offset % OTA_RANGE_SIZE)
+    {
+        memset(_state, 0, sizeof(OTA_State_t));
+        _state->magic = OTA_STATE_MAGIC;
+        _state->partition = partition->address;
+        _state->size = size;
+        memcpy(_state->sha256, sha256, 32);
+        sha256Begin(&_state->hash);
+    }
+    _status = OTA_IN_PROGRESS;
+    return true;
+#else
+    (void)gsm;
+    (void)url;
+    (void)size;
+    (void)sha256;
+    (void)state;
+    return false;
+#endif
+}
+
+OTA_Status_t A9G_OTA::poll()
+{
+    if (_status != OTA_IN_PROGRESS && _status != OTA_RETRY)
+    {
+        return _status;
+    }
+
+    if (_state->offset < _state->size)
+    {
+        _rangeLen = _state->size - _state->offset < OTA_RANGE_SIZE ? _state->size - _state->offset : OTA_RANGE_SIZE;
+        _received = 0;
+        _tooLong = false;
+
+        char url[OTA_MAX_URL_SIZE];
+        int len = snprintf(url, sizeof(url), "%s%crange=%lu-%lu", _url, strchr(_url, '?') ? '&' : '?',
+                           (unsigned long)_state->offset, (unsigned long)(_state->offset + _rangeLen - 1));
+        if (len < 0 || len >= (int)sizeof(url))
+        {
+            return _status = OTA_FAILED;
+        }
+
+        HTTP_Response_t response;
+        AT_Result_t result = _gsm->HTTPGet(url, this, &response);
+        bool success = response.status == 200 || response.status == 206;
+        if (success && (_tooLong || response.content_length > (long)_rangeLen))
+        {
+            // The server sent the whole file instead of the range, with or without a Content-Length.
+            return _status = OTA_FAILED;
+        }
+        bool whole_range = success && _received == _rangeLen && response.complete;
+        if (!result || !whole_range)
+        {
+            if (response.status >= 400 && response.status < 500)
+            {
+                return _status = OTA_FAILED;
+            }
+            return _status = ++_retries >= OTA_MAX_RETRIES ? OTA_FAILED : OTA_RETRY;
+        }
+
+        if (!_flashWrite(_state->offset, _range, _rangeLen))
+        {
+            return _status = OTA_FAILED;
+        }
+        sha256Update(&_state->hash, _range, _rangeLen);
+        _state->offset += _rangeLen;
+        _retries = 0;
+        if (_state->offset < _state->size)
+        {
+            return _status = OTA_IN_PROGRESS;
+        }
+    }
+
+    uint8_t digest[32];
+    SHA256_Context_t hash = _state->hash;
+    sha256Finish(&hash, digest);
+    _state->magic = 0;
+    if (memcmp(digest, _state->sha256, 32))
+    {
+        return _status = OTA_BAD_HASH;
+    }
+    return _status = _flashActivate() ? OTA_DONE : OTA_FAILED;
+}
+
+uint32_t A9G_OTA::offset()
+{
+    return _state->offset;
+}
+
+uint32_t A9G_OTA::size()
+{
+    return _state->size;
+}
+
+size_t A9G_OTA::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t A9G_OTA::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = _rangeLen - _received;
+    if (size < n)
+    {
+        n = size;
+    }
+    else if (size > n)
+    {
+        _tooLong = true;
+    }
+    memcpy(_range + _received, buffer, n);
+    _received += n;
+    return n;
+}
+
+bool A9G_OTA::_flashWrite(uint32_t offset, const uint8_t data[], size_t len)
+{
+#if defined(ESP32)
+    const esp_partition_t *partition = (const esp_partition_t *)_partition;
+    // Ranges are sector aligned; the last one may be short but its sector is still erased whole.
+    return esp_partition_erase_range(partition, offset, OTA_RANGE_SIZE) == ESP_OK &&
+           esp_partition_write(partition, offset, data, len) == ESP_OK;
+#else
+    (void)offset;
+    (void)data;
+    (void)len;
+    return false;
+#endif
+}
+
+bool A9G_OTA::_flashActivate()
+{
+#if defined(ESP32)
+    // Also checks the image header and segments.
+    return esp_ota_set_boot_partition((const esp_partition_t *)_partition) == ESP_OK;
+#else
+    return false;
+#endif
+}
+#endif
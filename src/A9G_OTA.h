@@ -0,0 +1,131 @@
+/*!
+ * @file A9G_OTA.h
+ *
+ * Firmware download over the A9/A9G into the ESP32 OTA partition.
+ *
+ * The image is fetched with GSM::HTTPGet() one OTA_RANGE_SIZE range at a time. Each range is
+ * collected in RAM, then its flash sector is erased and written and the running SHA-256 is
+ * advanced. Only whole ranges are committed, so after a link drop the download continues at the
+ * last good offset; with the state kept in RTC or NVS memory it continues after a reset as well.
+ * When the last range is in and the digest matches, the partition is made the boot partition.
+ *
+ * The AT+HTTPGET command cannot send a Range header, so the range is asked for in the query
+ * string: "<url>?range=<first>-<last>" (or "&range=..." if the URL has a query). The server must
+ * answer with exactly those bytes; a server that sends more, whether it announces a longer
+ * Content-Length or sends the whole file chunked, is reported as OTA_FAILED on the first range.
+ *
+ * The flash part needs the ESP32 partition API; on other targets begin() returns false. The
+ * SHA-256 is plain C and can be used on its own.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_OTA_H
+#define A9G_OTA_H
+
+#include <Arduino.h>
+#include "A9G.h"
+
+#define OTA_RANGE_SIZE 4096                 // bytes per request, one flash sector
+#define OTA_MAX_URL_SIZE 256
+#ifndef OTA_MAX_RETRIES
+#define OTA_MAX_RETRIES 5                   // consecutive failed ranges before giving up
+#endif
+#define OTA_STATE_MAGIC 0xA90A0001
+
+typedef struct SHA256_Context_t
+{
+    uint32_t state[8];
+    uint64_t length;        // bytes hashed
+    uint8_t block[64];
+} SHA256_Context_t;
+
+void sha256Begin(SHA256_Context_t *ctx);
+void sha256Update(SHA256_Context_t *ctx, const uint8_t data[], size_t len);
+void sha256Finish(SHA256_Context_t *ctx, uint8_t digest[32]);
+
+typedef enum OTA_Status_t
+{
+    OTA_IDLE = 0,
+    OTA_IN_PROGRESS,    // a range was written, call poll() again
+    OTA_RETRY,          // the range failed and will be asked for again; check the bearer before the next poll()
+    OTA_DONE,           // digest matched, the new image boots after a restart
+    OTA_BAD_HASH,       // the whole image arrived but its digest differs, the state is reset
+    OTA_FAILED          // too large, flash error, no range support or OTA_MAX_RETRIES reached
+} OTA_Status_t;
+
+/**
+ * Download progress, plain data so it can live in RTC_NOINIT_ATTR memory or NVS.
+ */
+typedef struct OTA_State_t
+{
+    uint32_t magic;         // OTA_STATE_MAGIC when valid
+    uint32_t partition;     // flash address of the target partition
+    uint32_t size;          // image size
+    uint32_t offset;        // bytes written and hashed
+    uint8_t sha256[32];     // expected digest
+    SHA256_Context_t hash;  // digest of the first offset bytes
+} OTA_State_t;
+
+#ifndef A9G_NO_HTTP
+class A9G_OTA : public Print
+{
+private:
+    GSM *_gsm = nullptr;
+    const char *_url = nullptr;
+    OTA_State_t _localState;
+    OTA_State_t *_state = &_localState;
+    const void *_partition = nullptr;   // const esp_partition_t *
+    OTA_Status_t _status = OTA_IDLE;
+    uint8_t _retries = 0;
+
+    uint8_t _range[OTA_RANGE_SIZE];
+    size_t _rangeLen = 0;               // bytes expected in the current range
+    size_t _received = 0;
+    bool _tooLong = false;              // the body went on past the range
+
+    bool _flashWrite(uint32_t offset, const uint8_t data[], size_t len);
+    bool _flashActivate();
+
+public:
+    /**
+     * @brief Starts or resumes a download into the next OTA partition.
+     *
+     * A state that carries OTA_STATE_MAGIC and describes the same image and partition is resumed at
+     * its offset, anything else is reset to 0.
+     *
+     * @param gsm A GSM with the data bearer up.
+     * @param url Location of the image, kept by the caller for the whole download.
+     * @param size Image size in bytes.
+     * @param sha256 Expected SHA-256 of the image.
+     * @param state Optional memory for the progress, e.g. RTC_NOINIT_ATTR.
+     * @return false if there is no OTA partition or the image does not fit.
+     */
+    bool begin(GSM *gsm, const char url[], uint32_t size, const uint8_t sha256[32], OTA_State_t *state = nullptr);
+
+    /**
+     * @brief Downloads and writes the next range. Blocks for one HTTP request.
+     */
+    OTA_Status_t poll();
+
+    /**
+     * @brief Bytes written so far.
+     */
+    uint32_t offset();
+
+    /**
+     * @brief Image size given to begin().
+     */
+    uint32_t size();
+
+    /**
+     * @brief Receives the body of the current range from GSM::HTTPGet().
+     */
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+};
+#endif
+
+#endif
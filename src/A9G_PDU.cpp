@@ -0,0 +1,738 @@
+/*!
+ * @file A9G_PDU.cpp
+ *
+ * SMS PDU mode (3GPP TS 23.040) encoder/decoder for the A9/A9G.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_PDU.h"
+
+#define GSM7_ESCAPE 0x1B
+#define GSM7_SINGLE_SEPTETS 160
+#define GSM7_MULTI_SEPTETS 153
+#define UCS2_SINGLE_UNITS 70
+#define UCS2_MULTI_UNITS 67
+#define CONCAT_UDH_OCTETS 6 // UDHL + IEI 0x00 + IEDL + ref + total + seq
+
+// GSM 03.38 default alphabet, index is the septet value.
+static const uint16_t _gsm7_table[128] PROGMEM = {
+    0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC, 0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+    0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8, 0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027, 0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+    0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0};
+
+// GSM 03.38 extension table, reached through the 0x1B escape: {septet, unicode}.
+static const uint16_t _gsm7_ext_table[][2] PROGMEM = {
+    {0x0A, 0x000C}, {0x14, 0x005E}, {0x28, 0x007B}, {0x29, 0x007D}, {0x2F, 0x005C},
+    {0x3C, 0x005B}, {0x3D, 0x007E}, {0x3E, 0x005D}, {0x40, 0x007C}, {0x65, 0x20AC}};
+
+#define GSM7_EXT_COUNT (sizeof(_gsm7_ext_table) / sizeof(_gsm7_ext_table[0]))
+
+/*###############################################*/
+/*******************  Helpers  *******************/
+/*###############################################*/
+
+static uint32_t _utf8Next(const char **p)
+{
+    const uint8_t *s = (const uint8_t *)*p;
+    uint32_t cp;
+    uint8_t extra;
+
+    if (s[0] < 0x80)
+    {
+        cp = s[0];
+        extra = 0;
+    }
+    else if ((s[0] & 0xE0) == 0xC0)
+    {
+        cp = s[0] & 0x1F;
+        extra = 1;
+    }
+    else if ((s[0] & 0xF0) == 0xE0)
+    {
+        cp = s[0] & 0x0F;
+        extra = 2;
+    }
+    else if ((s[0] & 0xF8) == 0xF0)
+    {
+        cp = s[0] & 0x07;
+        extra = 3;
+    }
+    else
+    {
+        *p += 1;
+        return 0xFFFD;
+    }
+
+    for (uint8_t i = 1; i <= extra; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            *p += i;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    *p += extra + 1;
+    return cp;
+}
+
+// Appends a code point as UTF-8, never splitting a sequence. Returns false when out of room.
+static bool _utf8Put(char out[], uint16_t *len, uint16_t size, uint32_t cp)
+{
+    uint8_t n = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+    if (*len + n >= size)
+    {
+        return false;
+    }
+
+    char *o = out + *len;
+    if (n == 1)
+    {
+        o[0] = cp;
+    }
+    else if (n == 2)
+    {
+        o[0] = 0xC0 | (cp >> 6);
+        o[1] = 0x80 | (cp & 0x3F);
+    }
+    else if (n == 3)
+    {
+        o[0] = 0xE0 | (cp >> 12);
+        o[1] = 0x80 | ((cp >> 6) & 0x3F);
+        o[2] = 0x80 | (cp & 0x3F);
+    }
+    else
+    {
+        o[0] = 0xF0 | (cp >> 18);
+        o[1] = 0x80 | ((cp >> 12) & 0x3F);
+        o[2] = 0x80 | ((cp >> 6) & 0x3F);
+        o[3] = 0x80 | (cp & 0x3F);
+    }
+    *len += n;
+    out[*len] = '\0';
+    return true;
+}
+
+// Returns the septet for a code point, with 0x100 set for extension table entries, or -1.
+static int _gsm7FromUnicode(uint32_t cp)
+{
+    for (uint8_t i = 0; i < 128; i++)
+    {
+        if (i != GSM7_ESCAPE && pgm_read_word(&_gsm7_table[i]) == cp)
+        {
+            return i;
+        }
+    }
+    for (uint8_t i = 0; i < GSM7_EXT_COUNT; i++)
+    {
+        if (pgm_read_word(&_gsm7_ext_table[i][1]) == cp)
+        {
+            return 0x100 | pgm_read_word(&_gsm7_ext_table[i][0]);
+        }
+    }
+    return -1;
+}
+
+static uint32_t _gsm7ExtToUnicode(uint8_t septet)
+{
+    for (uint8_t i = 0; i < GSM7_EXT_COUNT; i++)
+    {
+        if (pgm_read_word(&_gsm7_ext_table[i][0]) == septet)
+        {
+            return pgm_read_word(&_gsm7_ext_table[i][1]);
+        }
+    }
+    return 0x20;
+}
+
+// Units one code point takes: septets for GSM-7, UTF-16 code units for UCS-2.
+static uint8_t _units(uint32_t cp, PDU_Encoding_t encoding)
+{
+    if (encoding == PDU_GSM7)
+    {
+        return _gsm7FromUnicode(cp) & 0x100 ? 2 : 1;
+    }
+    return cp > 0xFFFF ? 2 : 1;
+}
+
+// Finds the UTF-8 range of a 1-based segment. Characters are never split across segments.
+static void _segmentBounds(const char utf8[], PDU_Encoding_t encoding, uint8_t parts, uint8_t part, const char **start, const char **end)
+{
+    uint16_t limit;
+    if (parts == 1)
+    {
+        limit = encoding == PDU_GSM7 ? GSM7_SINGLE_SEPTETS : UCS2_SINGLE_UNITS;
+    }
+    else
+    {
+        limit = encoding == PDU_GSM7 ? GSM7_MULTI_SEPTETS : UCS2_MULTI_UNITS;
+    }
+
+    const char *p = utf8;
+    uint8_t current = 1;
+    uint16_t used = 0;
+    *start = p;
+    while (*p)
+    {
+        const char *next = p;
+        uint8_t units = _units(_utf8Next(&next), encoding);
+        if (used + units > limit)
+        {
+            if (current == part)
+            {
+                break;
+            }
+            current++;
+            used = 0;
+            *start = p;
+        }
+        used += units;
+        p = next;
+    }
+    *end = p;
+    if (current != part)
+    {
+        *start = p;
+    }
+}
+
+static char _hexDigit(uint8_t v)
+{
+    return v < 10 ? '0' + v : 'A' + v - 10;
+}
+
+static int _hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static int _hexToBytes(const char hex[], uint8_t out[], int size)
+{
+    int n = 0;
+    while (hex[0] && hex[1] && n < size)
+    {
+        int hi = _hexValue(hex[0]);
+        int lo = _hexValue(hex[1]);
+        if (hi < 0 || lo < 0)
+        {
+            break;
+        }
+        out[n++] = (hi << 4) | lo;
+        hex += 2;
+    }
+    return n;
+}
+
+static void _putSeptet(uint8_t out[], uint16_t bit, uint8_t septet)
+{
+    out[bit / 8] |= septet << (bit % 8);
+    if (bit % 8 > 1)
+    {
+        out[bit / 8 + 1] |= septet >> (8 - bit % 8);
+    }
+}
+
+static uint8_t _getSeptet(const uint8_t in[], int in_len, uint16_t bit)
+{
+    uint16_t v = in[bit / 8];
+    if (bit / 8 + 1 < in_len)
+    {
+        v |= in[bit / 8 + 1] << 8;
+    }
+    return (v >> (bit % 8)) & 0x7F;
+}
+
+static bool _decodeGSM7(const uint8_t in[], int in_len, uint16_t start_bit, uint16_t septets, char out[], uint16_t *len, uint16_t size)
+{
+    bool escape = false;
+    for (uint16_t i = 0; i < septets; i++)
+    {
+        uint16_t bit = start_bit + i * 7;
+        if (bit / 8 >= in_len)
+        {
+            break;
+        }
+        uint8_t s = _getSeptet(in, in_len, bit);
+        if (s == GSM7_ESCAPE && !escape)
+        {
+            escape = true;
+            continue;
+        }
+        uint32_t cp = escape ? _gsm7ExtToUnicode(s) : pgm_read_word(&_gsm7_table[s]);
+        escape = false;
+        if (!_utf8Put(out, len, size, cp))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*###############################################*/
+/*******************  Encoder  *******************/
+/*###############################################*/
+
+uint8_t pduSegmentCount(const char utf8[], PDU_Encoding_t *encoding)
+{
+    PDU_Encoding_t enc = PDU_GSM7;
+    uint16_t units = 0;
+
+    for (const char *p = utf8; *p;)
+    {
+        if (_gsm7FromUnicode(_utf8Next(&p)) < 0)
+        {
+            enc = PDU_UCS2;
+            break;
+        }
+    }
+    for (const char *p = utf8; *p;)
+    {
+        units += _units(_utf8Next(&p), enc);
+    }
+    if (encoding)
+    {
+        *encoding = enc;
+    }
+
+    if (units <= (enc == PDU_GSM7 ? GSM7_SINGLE_SEPTETS : UCS2_SINGLE_UNITS))
+    {
+        return 1;
+    }
+
+    uint8_t parts = 1;
+    uint16_t used = 0;
+    uint16_t limit = enc == PDU_GSM7 ? GSM7_MULTI_SEPTETS : UCS2_MULTI_UNITS;
+    for (const char *p = utf8; *p;)
+    {
+        uint8_t n = _units(_utf8Next(&p), enc);
+        if (used + n > limit)
+        {
+            parts++;
+            used = 0;
+        }
+        used += n;
+    }
+    return parts;
+}
+
+int pduEncodeSubmit(char hex_out[], const char number[], const char utf8[], uint8_t part, uint8_t concat_ref, bool status_report)
+{
+    PDU_Encoding_t encoding;
+    uint8_t parts = pduSegmentCount(utf8, &encoding);
+    if (part < 1 || part > parts)
+    {
+        return -1;
+    }
+
+    uint8_t pdu[PDU_MAX_OCTETS];
+    memset(pdu, 0, sizeof(pdu));
+    int n = 0;
+
+    pdu[n++] = 0x00;                         // SCA: use the one stored in the module
+    pdu[n++] = (parts > 1 ? 0x41 : 0x01)     // SMS-SUBMIT, UDHI for concatenated messages
+               | (status_report ? 0x20 : 0x00); // TP-SRR
+
+    pdu[n++] = 0x00;                         // TP-MR, assigned by the module
+
+    const char *digits = number[0] == '+' ? number + 1 : number;
+    uint8_t digit_count = strlen(digits);
+    if (digit_count > (PDU_MAX_NUMBER_SIZE - 2))
+    {
+        return -1;
+    }
+    pdu[n++] = digit_count;
+    pdu[n++] = number[0] == '+' ? 0x91 : 0x81;
+    for (uint8_t i = 0; i < digit_count; i += 2)
+    {
+        uint8_t lo = digits[i] - '0';
+        uint8_t hi = i + 1 < digit_count ? digits[i + 1] - '0' : 0x0F;
+        pdu[n++] = (hi << 4) | (lo & 0x0F);
+    }
+
+    pdu[n++] = 0x00;                                     // TP-PID
+    pdu[n++] = encoding == PDU_UCS2 ? 0x08 : 0x00;      // TP-DCS
+    int udl_pos = n++;
+
+    uint8_t udh_octets = 0;
+    if (parts > 1)
+    {
+        pdu[n++] = CONCAT_UDH_OCTETS - 1;
+        pdu[n++] = 0x00;
+        pdu[n++] = 0x03;
+        pdu[n++] = concat_ref;
+        pdu[n++] = parts;
+        pdu[n++] = part;
+        udh_octets = CONCAT_UDH_OCTETS;
+    }
+
+    const char *start, *end;
+    _segmentBounds(utf8, encoding, parts, part, &start, &end);
+
+    if (encoding == PDU_GSM7)
+    {
+        uint16_t header_septets = (udh_octets * 8 + 6) / 7;
+        uint16_t septets = header_septets;
+        uint8_t *ud = pdu + udl_pos + 1;
+        for (const char *p = start; p < end;)
+        {
+            int s = _gsm7FromUnicode(_utf8Next(&p));
+            if (s & 0x100)
+            {
+                _putSeptet(ud, septets++ * 7, GSM7_ESCAPE);
+            }
+            _putSeptet(ud, septets++ * 7, s & 0x7F);
+        }
+        pdu[udl_pos] = septets;
+        n = udl_pos + 1 + (septets * 7 + 7) / 8;
+    }
+    else
+    {
+        for (const char *p = start; p < end;)
+        {
+            uint32_t cp = _utf8Next(&p);
+            if (cp > 0xFFFF)
+            {
+                cp -= 0x10000;
+                uint16_t high = 0xD800 | (cp >> 10);
+                pdu[n++] = high >> 8;
+                pdu[n++] = high & 0xFF;
+                cp = 0xDC00 | (cp & 0x3FF);
+            }
+            pdu[n++] = cp >> 8;
+            pdu[n++] = cp & 0xFF;
+        }
+        pdu[udl_pos] = n - udl_pos - 1;
+    }
+
+    if (hex_out)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            hex_out[i * 2] = _hexDigit(pdu[i] >> 4);
+            hex_out[i * 2 + 1] = _hexDigit(pdu[i] & 0x0F);
+        }
+        hex_out[n * 2] = '\0';
+    }
+
+    return n - 1; // AT+CMGS length excludes the SCA octet
+}
+
+/*###############################################*/
+/*******************  Decoder  *******************/
+/*###############################################*/
+
+static PDU_Encoding_t _encodingFromDCS(uint8_t dcs)
+{
+    if ((dcs & 0xC0) == 0x00)
+    {
+        uint8_t alphabet = (dcs >> 2) & 0x03;
+        return alphabet == 0x02 ? PDU_UCS2 : alphabet == 0x01 ? PDU_8BIT : PDU_GSM7;
+    }
+    if ((dcs & 0xF0) == 0xF0)
+    {
+        return dcs & 0x04 ? PDU_8BIT : PDU_GSM7;
+    }
+    if ((dcs & 0xF0) == 0xE0)
+    {
+        return PDU_UCS2;
+    }
+    return PDU_GSM7;
+}
+
+static uint8_t _bcd(uint8_t octet)
+{
+    // Semi-octets above 9 are invalid; keep the result to two digits.
+    return ((octet & 0x0F) * 10 + (octet >> 4)) % 100;
+}
+
+// Decodes a TP-OA/TP-RA address at *n into number[PDU_MAX_NUMBER_SIZE] and advances *n.
+static bool _decodeAddress(const uint8_t pdu[], int len, int *n, char number[])
+{
+    if (*n + 2 > len)
+        return false;
+    uint8_t digits = pdu[(*n)++];
+    uint8_t type = pdu[(*n)++];
+    uint8_t octets = (digits + 1) / 2;
+    if (*n + octets > len)
+        return false;
+
+    const uint8_t *a = pdu + *n;
+    if ((type & 0x70) == 0x50)
+    {
+        uint16_t number_len = 0;
+        number[0] = '\0';
+        _decodeGSM7(a, octets, 0, digits * 4 / 7, number, &number_len, PDU_MAX_NUMBER_SIZE);
+    }
+    else
+    {
+        uint8_t j = 0;
+        if ((type & 0x70) == 0x10)
+        {
+            number[j++] = '+';
+        }
+        for (uint8_t i = 0; i < digits && j < PDU_MAX_NUMBER_SIZE - 1; i++)
+        {
+            uint8_t d = i % 2 ? a[i / 2] >> 4 : a[i / 2] & 0x0F;
+            number[j++] = d < 10 ? '0' + d : d == 0x0A ? '*' : d == 0x0B ? '#' : 'A' + d - 0x0C;
+        }
+        number[j] = '\0';
+    }
+    *n += octets;
+    return true;
+}
+
+bool pduDecodeDeliver(const char hex[], PDU_Message_t *msg)
+{
+    uint8_t pdu[PDU_MAX_OCTETS];
+    int len = _hexToBytes(hex, pdu, sizeof(pdu));
+    int n = 0;
+
+    memset(msg, 0, sizeof(PDU_Message_t));
+    msg->part_count = 1;
+    msg->part_index = 1;
+
+    if (len < 1)
+        return false;
+    n += 1 + pdu[0]; // skip SCA
+
+    if (n >= len)
+        return false;
+    uint8_t first = pdu[n++];
+    if ((first & 0x03) != 0x00)
+    {
+        return false; // not an SMS-DELIVER
+    }
+    bool udhi = first & 0x40;
+
+    if (!_decodeAddress(pdu, len, &n, msg->number))
+        return false;
+
+    if (n + 2 + 7 + 1 > len)
+        return false;
+    n++; // TP-PID
+    msg->encoding = _encodingFromDCS(pdu[n++]);
+
+    const uint8_t *ts = pdu + n;
+    int tz = ((ts[6] & 0x07) * 10 + (ts[6] >> 4)) / 4;
+    if (ts[6] & 0x08)
+    {
+        tz = -tz;
+    }
+    snprintf(msg->date_time, sizeof(msg->date_time), "20%02u/%02u/%02u,%02u:%02u:%02u%+03d",
+             _bcd(ts[0]), _bcd(ts[1]), _bcd(ts[2]), _bcd(ts[3]), _bcd(ts[4]), _bcd(ts[5]), tz);
+    n += 7;
+
+    uint8_t udl = pdu[n++];
+    const uint8_t *ud = pdu + n;
+    int ud_len = len - n;
+    uint8_t udh_octets = 0;
+
+    if (udhi && ud_len > 0)
+    {
+        udh_octets = ud[0] + 1;
+        for (int i = 1; i + 1 < udh_octets && i + 1 < ud_len;)
+        {
+            uint8_t iei = ud[i];
+            uint8_t iedl = ud[i + 1];
+            if (iei == 0x00 && iedl == 3 && i + 4 < ud_len)
+            {
+                msg->concat_ref = ud[i + 2];
+                msg->part_count = ud[i + 3];
+                msg->part_index = ud[i + 4];
+            }
+            else if (iei == 0x08 && iedl == 4 && i + 5 < ud_len)
+            {
+                msg->concat_ref = (ud[i + 2] << 8) | ud[i + 3];
+                msg->part_count = ud[i + 4];
+                msg->part_index = ud[i + 5];
+            }
+            i += 2 + iedl;
+        }
+        if (msg->part_count == 0 || msg->part_index == 0 || msg->part_index > msg->part_count)
+        {
+            msg->part_count = 1;
+            msg->part_index = 1;
+        }
+    }
+
+    if (msg->encoding == PDU_GSM7)
+    {
+        uint16_t header_septets = (udh_octets * 8 + 6) / 7;
+        if (udl < header_septets)
+            return false;
+        _decodeGSM7(ud, ud_len, header_septets * 7, udl - header_septets, msg->text, &msg->text_len, sizeof(msg->text));
+    }
+    else if (msg->encoding == PDU_UCS2)
+    {
+        int end = udl < ud_len ? udl : ud_len;
+        for (int i = udh_octets; i + 1 < end; i += 2)
+        {
+            uint32_t cp = (ud[i] << 8) | ud[i + 1];
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < end)
+            {
+                uint32_t low = (ud[i + 2] << 8) | ud[i + 3];
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+            if (!_utf8Put(msg->text, &msg->text_len, sizeof(msg->text), cp))
+                break;
+        }
+    }
+    else
+    {
+        int end = udl < ud_len ? udl : ud_len;
+        for (int i = udh_octets; i < end; i++)
+        {
+            if (!_utf8Put(msg->text, &msg->text_len, sizeof(msg->text), ud[i]))
+                break;
+        }
+    }
+
+    return true;
+}
+
+bool pduDecodeStatusReport(const char hex[], uint8_t *mr, char number[], uint8_t *status)
+{
+    uint8_t pdu[PDU_MAX_OCTETS];
+    int len = _hexToBytes(hex, pdu, sizeof(pdu));
+    int n = 0;
+
+    if (len < 1)
+        return false;
+    n += 1 + pdu[0]; // skip SCA
+
+    if (n + 2 > len || (pdu[n] & 0x03) != 0x02)
+    {
+        return false; // not an SMS-STATUS-REPORT
+    }
+    n++;
+    *mr = pdu[n++];
+
+    if (!_decodeAddress(pdu, len, &n, number))
+        return false;
+
+    n += 7 + 7; // TP-SCTS, TP-DT
+    if (n >= len)
+        return false;
+    *status = pdu[n];
+    return true;
+}
+
+/*###############################################*/
+/*****************  Reassembler  *****************/
+/*###############################################*/
+
+PDU_Reassembler::PDU_Reassembler()
+{
+    memset(_slots, 0, sizeof(_slots));
+}
+
+PDU_Reassembler::Slot_t *PDU_Reassembler::_findSlot(const PDU_Message_t *part)
+{
+    Slot_t *free_slot = nullptr;
+    Slot_t *oldest = &_slots[0];
+
+    for (uint8_t i = 0; i < PDU_REASSEMBLY_SLOTS; i++)
+    {
+        Slot_t *slot = &_slots[i];
+        if (slot->used && millis() - slot->lastMS >= PDU_REASSEMBLY_TIMEOUT_MS)
+        {
+            slot->used = false;
+            _dropped++;
+        }
+        if (!slot->used)
+        {
+            if (!free_slot)
+                free_slot = slot;
+            continue;
+        }
+        if (slot->ref == part->concat_ref && slot->total == part->part_count && !strcmp(slot->number, part->number))
+        {
+            return slot;
+        }
+        if (slot->lastMS - oldest->lastMS > 0x7FFFFFFF) // slot is older, wrap safe
+        {
+            oldest = slot;
+        }
+    }
+
+    Slot_t *slot = free_slot;
+    if (!slot)
+    {
+        slot = oldest;
+        _dropped++;
+    }
+    memset(slot, 0, sizeof(Slot_t));
+    slot->used = true;
+    slot->ref = part->concat_ref;
+    slot->total = part->part_count;
+    strcpy(slot->number, part->number);
+    return slot;
+}
+
+const char *PDU_Reassembler::add(const PDU_Message_t *part, uint16_t *text_len)
+{
+    if (part->part_count <= 1)
+    {
+        // Copied, the caller's segment is usually freed before the text is delivered.
+        memcpy(_single, part->text, part->text_len);
+        _single[part->text_len] = '\0';
+        *text_len = part->text_len;
+        return _single;
+    }
+    if (part->part_count > PDU_REASSEMBLY_PARTS)
+    {
+        _dropped++;
+        return nullptr;
+    }
+
+    Slot_t *slot = _findSlot(part);
+    uint8_t bit = 1 << (part->part_index - 1);
+    slot->lastMS = millis();
+    if (!(slot->received & bit))
+    {
+        slot->received |= bit;
+        slot->len[part->part_index - 1] = part->text_len;
+        memcpy(slot->text[part->part_index - 1], part->text, part->text_len);
+    }
+
+    if (slot->received != (1 << slot->total) - 1)
+    {
+        return nullptr;
+    }
+
+    // All segments present: pack them into the start of the slot's storage.
+    char *out = slot->text[0];
+    uint16_t len = slot->len[0];
+    for (uint8_t i = 1; i < slot->total; i++)
+    {
+        memmove(out + len, slot->text[i], slot->len[i]);
+        len += slot->len[i];
+    }
+    if (len >= sizeof(slot->text))
+    {
+        len = sizeof(slot->text) - 1;
+    }
+    out[len] = '\0';
+    slot->used = false;
+    *text_len = len;
+    return out;
+}
+
+uint8_t PDU_Reassembler::dropped()
+{
+    return _dropped;
+}
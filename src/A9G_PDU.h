@@ -0,0 +1,151 @@
+/*!
+ * @file A9G_PDU.h
+ *
+ * SMS PDU mode (3GPP TS 23.040) encoder/decoder for the A9/A9G.
+ *
+ * Text is exchanged with the application as UTF-8. Outgoing messages are packed as GSM-7
+ * when every character fits the default alphabet (160 chars per segment) and as UCS-2
+ * otherwise (70 chars per segment). Longer messages are split into concatenated segments
+ * with a UDH, and incoming segments are reassembled in a small bounded table.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_PDU_H
+#define A9G_PDU_H
+
+#include <Arduino.h>
+
+#define PDU_MAX_NUMBER_SIZE 22                  // "+", up to 20 digits and the terminator
+#define PDU_MAX_OCTETS 176                      // SCA + longest SMS-SUBMIT/DELIVER TPDU
+#define PDU_MAX_HEX_SIZE (PDU_MAX_OCTETS * 2 + 1)
+
+#ifndef PDU_REASSEMBLY_SLOTS
+#define PDU_REASSEMBLY_SLOTS 2                  // concurrent multipart messages being reassembled
+#endif
+#ifndef PDU_REASSEMBLY_PARTS
+#define PDU_REASSEMBLY_PARTS 4                  // max segments per reassembled message
+#endif
+#if PDU_REASSEMBLY_PARTS > 8
+#error "PDU_REASSEMBLY_PARTS must be 8 or less"
+#endif
+#ifndef PDU_PART_TEXT_SIZE
+#define PDU_PART_TEXT_SIZE 320                  // UTF-8 bytes kept per segment
+#endif
+#ifndef PDU_REASSEMBLY_TIMEOUT_MS
+#define PDU_REASSEMBLY_TIMEOUT_MS 120000        // incomplete messages older than this are dropped
+#endif
+
+typedef enum PDU_Encoding_t
+{
+    PDU_GSM7 = 0,
+    PDU_8BIT,
+    PDU_UCS2
+} PDU_Encoding_t;
+
+/**
+ * @brief One decoded SMS-DELIVER segment.
+ */
+typedef struct PDU_Message_t
+{
+    char number[PDU_MAX_NUMBER_SIZE];
+    char date_time[25];         // same layout as text mode: "2023/10/19,14:18:26+06"
+    PDU_Encoding_t encoding;
+    uint16_t concat_ref;        // concatenation reference, valid if part_count > 1
+    uint8_t part_count;         // 1 for a single segment message
+    uint8_t part_index;         // 1-based
+    uint16_t text_len;
+    char text[PDU_PART_TEXT_SIZE]; // UTF-8, null terminated
+} PDU_Message_t;
+
+/**
+ * @brief Picks the encoding for a UTF-8 text and counts the segments needed to send it.
+ *
+ * @param utf8 The message text.
+ * @param encoding Receives PDU_GSM7 or PDU_UCS2.
+ * @return Number of segments (1 for a single SMS).
+ */
+uint8_t pduSegmentCount(const char utf8[], PDU_Encoding_t *encoding);
+
+/**
+ * @brief Encodes one segment of a message as an SMS-SUBMIT PDU in hex.
+ *
+ * The PDU starts with an empty SCA ("00") so the module uses its stored service centre.
+ *
+ * @param hex_out Output buffer of at least PDU_MAX_HEX_SIZE bytes, or nullptr to only compute the length.
+ * @param number Destination number, a leading '+' selects international format.
+ * @param utf8 The full message text.
+ * @param part 1-based segment to encode.
+ * @param concat_ref Concatenation reference shared by all segments of this message.
+ * @param status_report Request a delivery report (+CDS) from the service centre.
+ * @return TPDU length in octets for AT+CMGS=<length>, or -1 on error.
+ */
+int pduEncodeSubmit(char hex_out[], const char number[], const char utf8[], uint8_t part, uint8_t concat_ref, bool status_report = false);
+
+/**
+ * @brief Decodes an SMS-DELIVER PDU given in hex (as returned by AT+CMGR in PDU mode).
+ *
+ * @param hex The PDU, including the SCA.
+ * @param msg Receives the decoded segment.
+ * @return true if the PDU was a valid SMS-DELIVER, false otherwise.
+ */
+bool pduDecodeDeliver(const char hex[], PDU_Message_t *msg);
+
+/**
+ * @brief Decodes an SMS-STATUS-REPORT PDU given in hex (as delivered with +CDS in PDU mode).
+ *
+ * @param hex The PDU, including the SCA.
+ * @param mr Receives the TP-MR of the message the report refers to.
+ * @param number Receives the recipient address, at least PDU_MAX_NUMBER_SIZE bytes.
+ * @param status Receives TP-ST, 0x00-0x1F means the message was delivered.
+ * @return true if the PDU was a valid SMS-STATUS-REPORT, false otherwise.
+ */
+bool pduDecodeStatusReport(const char hex[], uint8_t *mr, char number[], uint8_t *status);
+
+/**
+ * @brief Bounded reassembly table for concatenated SMS.
+ *
+ * Segments are grouped by sender and concatenation reference. When the table is full the
+ * oldest incomplete message is dropped to make room.
+ */
+class PDU_Reassembler
+{
+private:
+    typedef struct Slot_t
+    {
+        bool used;
+        char number[PDU_MAX_NUMBER_SIZE];
+        uint16_t ref;
+        uint8_t total;
+        uint8_t received;       // bitmask of segments present
+        unsigned long lastMS;
+        uint16_t len[PDU_REASSEMBLY_PARTS];
+        char text[PDU_REASSEMBLY_PARTS][PDU_PART_TEXT_SIZE];
+    } Slot_t;
+
+    Slot_t _slots[PDU_REASSEMBLY_SLOTS];
+    char _single[PDU_PART_TEXT_SIZE];   // text of the last single segment message
+    uint8_t _dropped = 0;
+
+    Slot_t *_findSlot(const PDU_Message_t *part);
+
+public:
+    PDU_Reassembler();
+
+    /**
+     * @brief Adds a decoded segment.
+     *
+     * @param part The segment. Single segment messages complete immediately.
+     * @param text_len Receives the length of the completed text.
+     * @return The complete UTF-8 text when this segment finished a message, valid until the next add(); nullptr otherwise.
+     */
+    const char *add(const PDU_Message_t *part, uint16_t *text_len);
+
+    /**
+     * @brief Number of incomplete messages dropped because the table was full or they timed out.
+     */
+    uint8_t dropped();
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*!
+ * @file A9G_RxBuffer.cpp
+ *
+ * Receive buffer between the module UART and the AT parser.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_RxBuffer.h"
+
+size_t A9G_RxBuffer::fill(Stream *stream)
+{
+    if (_start == _end)
+    {
+        _start = 0;
+        _scan = 0;
+        _end = 0;
+    }
+    else if (_end == RX_BUFFER_SIZE && _start > 0)
+    {
+        memmove(_buffer, _buffer + _start, _end - _start);
+        _scan -= _start;
+        _end -= _start;
+        _start = 0;
+    }
+
+    int available = stream->available();
+    size_t room = RX_BUFFER_SIZE - _end;
+    if (available <= 0 || room == 0)
+    {
+        return 0;
+    }
+    if ((size_t)available < room)
+    {
+        room = available;
+    }
+    size_t n = stream->readBytes(_buffer + _end, room);
+    _end += n;
+    return n;
+}
+
+char *A9G_RxBuffer::readLine(size_t *len)
+{
+    while (true)
+    {
+        char *lf = (char *)memchr(_buffer + _scan, '\n', _end - _scan);
+        char *line = _buffer + _start;
+        size_t line_len;
+
+        if (lf)
+        {
+            line_len = lf - line;
+            _start = lf - _buffer + 1;
+            _scan = _start;
+        }
+        else
+        {
+            _scan = _end;
+            if (_end - _start < RX_BUFFER_SIZE)
+            {
+                return nullptr;
+            }
+            // Full buffer and still no LF: hand out what we have, drop the rest of the line.
+            line_len = RX_BUFFER_SIZE;
+            _start = _end;
+            if (!_discard)
+            {
+                overflows++;
+                _discard = true;
+                line[line_len] = '\0';
+                *len = line_len;
+                return line;
+            }
+            continue;
+        }
+
+        if (_discard)
+        {
+            _discard = false;
+            continue;
+        }
+
+        line[line_len] = '\0';
+        if (line_len && line[line_len - 1] == '\r')
+        {
+            line[--line_len] = '\0';
+        }
+        if (line_len)
+        {
+            *len = line_len;
+            return line;
+        }
+    }
+}
+
+size_t A9G_RxBuffer::pending()
+{
+    return _end - _start;
+}
+
+const char *A9G_RxBuffer::peek()
+{
+    return _buffer + _start;
+}
+
+void A9G_RxBuffer::consume(size_t n)
+{
+    if (n > _end - _start)
+    {
+        n = _end - _start;
+    }
+    _start += n;
+    if (_scan < _start)
+    {
+        _scan = _start;
+    }
+}
+
+void A9G_RxBuffer::clear()
+{
+    _start = 0;
+    _scan = 0;
+    _end = 0;
+    _discard = false;
+}
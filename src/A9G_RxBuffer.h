@@ -0,0 +1,74 @@
+/*!
+ * @file A9G_RxBuffer.h
+ *
+ * Receive buffer between the module UART and the AT parser.
+ *
+ * Bytes are pulled from the stream in bulk with readBytes() and the parser takes whole lines out
+ * of the buffer, found with memchr(). Lines are handed out in place, null terminated and without
+ * their CR/LF, and stay valid until the next fill(). A line that does not fit RX_BUFFER_SIZE with
+ * its CR/LF is handed out truncated to RX_BUFFER_SIZE bytes and the rest of it, up to its LF, is
+ * dropped.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_RXBUFFER_H
+#define A9G_RXBUFFER_H
+
+#include <Arduino.h>
+#include <Stream.h>
+
+#ifndef RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE 512 // longest line kept whole, counting its CR/LF
+#endif
+
+class A9G_RxBuffer
+{
+private:
+    char _buffer[RX_BUFFER_SIZE + 1]; // +1 so a full buffer can still be null terminated
+    size_t _start = 0;                // first unread byte
+    size_t _scan = 0;                 // bytes before this were already searched for LF
+    size_t _end = 0;                  // one past the last buffered byte
+    bool _discard = false;            // dropping the rest of a truncated line
+
+public:
+    uint32_t overflows = 0; // lines truncated
+
+    /**
+     * @brief Moves whatever the stream has available into the buffer, without blocking.
+     *
+     * @return Number of bytes read.
+     */
+    size_t fill(Stream *stream);
+
+    /**
+     * @brief Takes the next non-empty line out of the buffer.
+     *
+     * @param len Receives the length of the line.
+     * @return The line, null terminated, or nullptr if no complete line is buffered.
+     */
+    char *readLine(size_t *len);
+
+    /**
+     * @brief Unread bytes, including an incomplete line.
+     */
+    size_t pending();
+
+    /**
+     * @brief Start of the unread bytes, for input that is not line terminated such as the SMS prompt.
+     */
+    const char *peek();
+
+    /**
+     * @brief Drops unread bytes.
+     */
+    void consume(size_t n);
+
+    /**
+     * @brief Drops everything buffered.
+     */
+    void clear();
+};
+
+#endif
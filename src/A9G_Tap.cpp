@@ -0,0 +1,131 @@
+/*!
+ * @file A9G_Tap.cpp
+ *
+ * Stream wrapper between GSM and the module transport, used to account for every byte in and out,
+ * optionally to record them with an A9G_Trace, and to wake the module from sleep before writing.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Tap.h"
+
+void A9G_Tap::begin(A9G_Transport *transport)
+{
+    _transport = transport;
+}
+
+bool A9G_Tap::wait(unsigned long timeout_ms)
+{
+    return _transport->wait(timeout_ms);
+}
+
+bool A9G_Tap::setFlowControl(bool enable)
+{
+    return _transport->setFlowControl(enable);
+}
+
+uint32_t A9G_Tap::overruns()
+{
+    return _transport->overruns();
+}
+
+void A9G_Tap::setWake(unsigned long idle_ms, unsigned long delay_ms)
+{
+    _wakeIdleMS = idle_ms;
+    _wakeDelayMS = delay_ms;
+    _lastActivityMS = millis();
+}
+
+void A9G_Tap::_wake()
+{
+    if (!_wakeIdleMS)
+    {
+        return;
+    }
+    if (millis() - _lastActivityMS >= _wakeIdleMS)
+    {
+        // The byte that wakes the UART may be lost; a lone CR is ignored by the AT parser either way.
+        uint8_t cr = '\r';
+        bytesWritten += _transport->write(&cr, 1);
+        if (trace)
+        {
+            trace->record(TRACE_TX, '\r');
+        }
+        delay(_wakeDelayMS);
+    }
+    _lastActivityMS = millis();
+}
+
+int A9G_Tap::available()
+{
+    return _transport->available();
+}
+
+int A9G_Tap::read()
+{
+    uint8_t c;
+    if (_transport->read(&c, 1))
+    {
+        bytesRead++;
+        if (_wakeIdleMS)
+        {
+            _lastActivityMS = millis();
+        }
+        if (trace)
+        {
+            trace->record(TRACE_RX, c);
+        }
+        return c;
+    }
+    return -1;
+}
+
+size_t A9G_Tap::readBytes(char *buffer, size_t length)
+{
+    size_t n = _transport->read((uint8_t *)buffer, length);
+    bytesRead += n;
+    if (n && _wakeIdleMS)
+    {
+        _lastActivityMS = millis();
+    }
+    for (size_t i = 0; trace && i < n; i++)
+    {
+        trace->record(TRACE_RX, buffer[i]);
+    }
+    return n;
+}
+
+int A9G_Tap::peek()
+{
+    return _transport->peek();
+}
+
+void A9G_Tap::flush()
+{
+    _transport->flush();
+}
+
+size_t A9G_Tap::write(uint8_t c)
+{
+    _wake();
+    size_t n = _transport->write(&c, 1);
+    bytesWritten += n;
+    if (trace && n)
+    {
+        trace->record(TRACE_TX, c);
+    }
+    return n;
+}
+
+size_t A9G_Tap::write(const uint8_t *buffer, size_t size)
+{
+    _wake();
+    size_t n = _transport->write(buffer, size);
+    bytesWritten += n;
+    for (size_t i = 0; trace && i < n; i++)
+    {
+        trace->record(TRACE_TX, buffer[i]);
+    }
+    return n;
+}
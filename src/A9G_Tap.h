@@ -0,0 +1,76 @@
+/*!
+ * @file A9G_Tap.h
+ *
+ * Stream wrapper between GSM and the module transport, used to account for every byte in and out,
+ * optionally to record them with an A9G_Trace, and to wake the module from sleep before writing.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_TAP_H
+#define A9G_TAP_H
+
+#include <Arduino.h>
+#include <Stream.h>
+#include "A9G_Trace.h"
+#include "A9G_Transport.h"
+
+class A9G_Tap : public Stream
+{
+private:
+    A9G_Transport *_transport = nullptr;
+    unsigned long _wakeIdleMS = 0;
+    unsigned long _wakeDelayMS = 0;
+    unsigned long _lastActivityMS = 0;
+
+    void _wake();
+
+public:
+    uint32_t bytesRead = 0;
+    uint32_t bytesWritten = 0;
+    A9G_Trace *trace = nullptr;
+
+    /**
+     * @brief Sets the transport all calls are forwarded to.
+     */
+    void begin(A9G_Transport *transport);
+
+    /**
+     * @brief Waits up to timeout_ms for received data, see A9G_Transport::wait().
+     */
+    bool wait(unsigned long timeout_ms);
+
+    /**
+     * @brief See A9G_Transport::setFlowControl().
+     */
+    bool setFlowControl(bool enable);
+
+    /**
+     * @brief See A9G_Transport::overruns().
+     */
+    uint32_t overruns();
+
+    /**
+     * @brief Wakes a sleeping module before the first write after a quiet period.
+     *
+     * When nothing was sent or received for idle_ms, a CR is written and the write waits delay_ms
+     * so the module is awake before the actual command arrives.
+     *
+     * @param idle_ms Quiet time after which the module may be asleep, 0 to disable.
+     * @param delay_ms Time the module needs to wake up.
+     */
+    void setWake(unsigned long idle_ms, unsigned long delay_ms);
+
+    int available();
+    int read();
+    int peek();
+    size_t readBytes(char *buffer, size_t length);
+    void flush();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    using Stream::readBytes;
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*!
+ * @file A9G_Trace.cpp
+ *
+ * Binary UART trace recorder and replay stream for the A9/A9G.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Trace.h"
+
+bool A9G_Trace::begin(uint8_t buffer[], size_t size)
+{
+    // A record is at most 1 + 5 + TRACE_MAX_RUN bytes, so a buffer of two records never has to
+    // evict the record still being written.
+    if (buffer == nullptr || size < TRACE_MIN_SIZE)
+    {
+        return false;
+    }
+    _buffer = buffer;
+    _size = size;
+    clear();
+    return true;
+}
+
+void A9G_Trace::clear()
+{
+    _head = 0;
+    _tail = 0;
+    _count = 0;
+    _open = false;
+    overwritten = 0;
+}
+
+void A9G_Trace::pause(bool paused)
+{
+    _paused = paused;
+    _open = false;
+}
+
+size_t A9G_Trace::size()
+{
+    return _count;
+}
+
+uint8_t A9G_Trace::_at(size_t offset)
+{
+    return _buffer[(_tail + offset) % _size];
+}
+
+void A9G_Trace::_evict()
+{
+    size_t len = 1 + (_at(0) & TRACE_MAX_RUN);
+    size_t i = 1;
+    while (_at(i) & 0x80)
+    {
+        i++;
+    }
+    len += i;
+    _tail = (_tail + len) % _size;
+    _count -= len;
+    overwritten++;
+}
+
+void A9G_Trace::_put(uint8_t b)
+{
+    while (_count >= _size)
+    {
+        _evict();
+    }
+    _buffer[_head] = b;
+    _head = (_head + 1) % _size;
+    _count++;
+}
+
+void A9G_Trace::record(Trace_Direction_t dir, uint8_t c)
+{
+    if (_buffer == nullptr || _paused)
+    {
+        return;
+    }
+
+    unsigned long now = micros();
+    if (_open && _openDir == dir && _openLen < TRACE_MAX_RUN && now - _lastUS < TRACE_RUN_GAP_US)
+    {
+        _put(c);
+        _openLen++;
+        _buffer[_openHeader] = (dir << 7) | _openLen;
+    }
+    else
+    {
+        uint32_t delta = now - _lastUS;
+        _openHeader = _head;
+        _openDir = dir;
+        _openLen = 1;
+        _open = true;
+        _put((dir << 7) | 1);
+        do
+        {
+            uint8_t b = delta & 0x7F;
+            delta >>= 7;
+            _put(delta ? (b | 0x80) : b);
+        } while (delta);
+        _put(c);
+    }
+    _lastUS = now;
+}
+
+size_t A9G_Trace::dump(Print &out)
+{
+    bool paused = _paused;
+    pause(true);
+
+    size_t n = out.write((const uint8_t *)TRACE_MAGIC, 4);
+    n += out.write((uint8_t)TRACE_FORMAT_VERSION);
+    n += out.write((uint8_t)0);
+
+    size_t first = _count;
+    if (_tail + first > _size)
+    {
+        first = _size - _tail;
+    }
+    n += out.write(_buffer + _tail, first);
+    if (first < _count)
+    {
+        n += out.write(_buffer, _count - first);
+    }
+
+    pause(paused);
+    return n;
+}
+
+A9G_TraceReplay::A9G_TraceReplay(const uint8_t trace[], size_t len, bool realtime)
+{
+    _trace = trace;
+    _len = len;
+    _realtime = realtime;
+    _pos = len;
+    if (len >= TRACE_HEADER_SIZE && memcmp(trace, TRACE_MAGIC, 4) == 0 && trace[4] == TRACE_FORMAT_VERSION)
+    {
+        _pos = TRACE_HEADER_SIZE;
+    }
+}
+
+bool A9G_TraceReplay::_nextRx()
+{
+    while (_remaining == 0)
+    {
+        if (_pos >= _len)
+        {
+            return false;
+        }
+
+        bool first = _pos == TRACE_HEADER_SIZE && !_started;
+        uint8_t header = _trace[_pos++];
+        uint32_t delta = 0;
+        uint8_t shift = 0;
+        while (_pos < _len)
+        {
+            uint8_t b = _trace[_pos++];
+            if (shift < 32)
+            {
+                delta |= (uint32_t)(b & 0x7F) << shift;
+            }
+            shift += 7;
+            if (!(b & 0x80))
+            {
+                break;
+            }
+        }
+        if (!first)
+        {
+            _recordUS += delta;
+        }
+
+        uint8_t len = header & TRACE_MAX_RUN;
+        if (_pos + len > _len)
+        {
+            len = _len - _pos;
+        }
+        if (header & 0x80)
+        {
+            // TX bytes are what GSM is expected to send, they are not fed back
+            _pos += len;
+        }
+        else
+        {
+            _remaining = len;
+        }
+
+        if (!_started)
+        {
+            _started = true;
+            _startUS = micros();
+        }
+    }
+    return true;
+}
+
+bool A9G_TraceReplay::finished()
+{
+    return !_nextRx();
+}
+
+int A9G_TraceReplay::available()
+{
+    if (!_nextRx())
+    {
+        return 0;
+    }
+    if (_realtime && micros() - _startUS < _recordUS)
+    {
+        return 0;
+    }
+    return _remaining;
+}
+
+int A9G_TraceReplay::read()
+{
+    if (available() == 0)
+    {
+        return -1;
+    }
+    _remaining--;
+    return _trace[_pos++];
+}
+
+int A9G_TraceReplay::peek()
+{
+    if (available() == 0)
+    {
+        return -1;
+    }
+    return _trace[_pos];
+}
+
+size_t A9G_TraceReplay::write(uint8_t c)
+{
+    (void)c;
+    bytesWritten++;
+    return 1;
+}
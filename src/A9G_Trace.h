@@ -0,0 +1,144 @@
+/*!
+ * @file A9G_Trace.h
+ *
+ * Binary UART trace recorder and replay stream for the A9/A9G.
+ *
+ * A9G_Trace records every byte passing between GSM and the module into a caller supplied ring
+ * buffer. Bytes going the same direction within TRACE_RUN_GAP_US of each other are grouped into
+ * one record:
+ *
+ *   header   1 byte   bit 7: direction (1 = to module, 0 = from module), bits 0-6: length 1-127
+ *   delta    varint   microseconds since the previous record (unsigned LEB128)
+ *   payload  length bytes
+ *
+ * dump() writes TRACE_MAGIC, TRACE_FORMAT_VERSION and a flags byte followed by the records, oldest
+ * first. The first record's delta is relative to an earlier, possibly overwritten record and should
+ * be treated as 0. extras/trace/a9g_trace.py decodes dumps and replays them to a device.
+ *
+ * A9G_TraceReplay plays such a dump back as a Stream, so it can be handed to GSM::init() to run the
+ * parser against a recorded session.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_TRACE_H
+#define A9G_TRACE_H
+
+#include <Arduino.h>
+#include <Stream.h>
+
+#define TRACE_MAGIC "A9GT"
+#define TRACE_FORMAT_VERSION 1
+#define TRACE_HEADER_SIZE 6
+#define TRACE_MIN_SIZE 512
+#define TRACE_RUN_GAP_US 2000
+#define TRACE_MAX_RUN 127
+
+typedef enum Trace_Direction_t
+{
+    TRACE_RX = 0, // module -> MCU
+    TRACE_TX = 1  // MCU -> module
+} Trace_Direction_t;
+
+class A9G_Trace
+{
+private:
+    uint8_t *_buffer = nullptr;
+    size_t _size = 0;
+    size_t _head = 0;   // next write position
+    size_t _tail = 0;   // oldest record
+    size_t _count = 0;  // bytes in use
+
+    bool _open = false; // the newest record can still be extended
+    size_t _openHeader = 0;
+    uint8_t _openDir = 0;
+    uint8_t _openLen = 0;
+    unsigned long _lastUS = 0;
+    bool _paused = false;
+
+    void _put(uint8_t b);
+    void _evict();
+    uint8_t _at(size_t offset);
+
+public:
+    uint32_t overwritten = 0; // records dropped to make room
+
+    /**
+     * @brief Starts recording into a buffer.
+     *
+     * @param buffer Ring buffer storage, kept by the caller.
+     * @param size Size of the buffer, at least TRACE_MIN_SIZE.
+     * @return false if the buffer is too small.
+     */
+    bool begin(uint8_t buffer[], size_t size);
+
+    /**
+     * @brief Records one byte.
+     */
+    void record(Trace_Direction_t dir, uint8_t c);
+
+    /**
+     * @brief Stops or resumes recording without losing the buffer.
+     */
+    void pause(bool paused);
+
+    /**
+     * @brief Drops all recorded data.
+     */
+    void clear();
+
+    /**
+     * @brief Bytes of trace data currently held, excluding the dump header.
+     */
+    size_t size();
+
+    /**
+     * @brief Writes the trace, oldest record first, to any Print (Serial, a flash File, ...).
+     *
+     * Recording is paused while dumping.
+     *
+     * @return Number of bytes written including the header.
+     */
+    size_t dump(Print &out);
+};
+
+class A9G_TraceReplay : public Stream
+{
+private:
+    const uint8_t *_trace;
+    size_t _len;
+    size_t _pos;
+    uint8_t _remaining = 0;     // payload bytes left in the current RX record
+    bool _realtime;
+    bool _started = false;
+    unsigned long _startUS = 0;
+    uint32_t _recordUS = 0;     // trace time of the current record
+
+    bool _nextRx();
+
+public:
+    uint32_t bytesWritten = 0;
+
+    /**
+     * @brief Replays a dump produced by A9G_Trace::dump().
+     *
+     * @param trace The dump, including its header.
+     * @param len Length of the dump.
+     * @param realtime true to release bytes with the recorded timing, false to release them as fast as they are read.
+     */
+    A9G_TraceReplay(const uint8_t trace[], size_t len, bool realtime);
+
+    /**
+     * @brief true once every recorded RX byte has been read.
+     */
+    bool finished();
+
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+};
+
+#endif
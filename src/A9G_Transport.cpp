@@ -0,0 +1,195 @@
+/*!
+ * @file A9G_Transport.cpp
+ *
+ * Byte transport between GSM and the module.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#include "A9G_Transport.h"
+
+void A9G_StreamTransport::begin(Stream *stream)
+{
+    _stream = stream;
+}
+
+int A9G_StreamTransport::available()
+{
+    return _stream->available();
+}
+
+size_t A9G_StreamTransport::read(uint8_t *buffer, size_t length)
+{
+    int available = _stream->available();
+    if (available <= 0)
+    {
+        return 0;
+    }
+    if ((size_t)available < length)
+    {
+        length = available;
+    }
+    // Never more than available, so the Stream timeout does not apply.
+    return _stream->readBytes((char *)buffer, length);
+}
+
+int A9G_StreamTransport::peek()
+{
+    return _stream->peek();
+}
+
+size_t A9G_StreamTransport::write(const uint8_t *buffer, size_t size)
+{
+    return _stream->write(buffer, size);
+}
+
+void A9G_StreamTransport::flush()
+{
+    _stream->flush();
+}
+
+#if defined(ESP32)
+bool A9G_UartTransport::begin(uart_port_t port, uint32_t baud, int rx_pin, int tx_pin, int rts_pin, int cts_pin)
+{
+    end();
+
+    uart_config_t config = {};
+    config.baud_rate = baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    // source_clk stays 0, which the driver takes as the default clock.
+
+    if (uart_param_config(port, &config) != ESP_OK ||
+        uart_set_pin(port, tx_pin, rx_pin, rts_pin, cts_pin) != ESP_OK ||
+        uart_driver_install(port, TRANSPORT_RX_RING_SIZE, TRANSPORT_TX_RING_SIZE, TRANSPORT_EVENT_QUEUE_SIZE, &_queue, 0) != ESP_OK)
+    {
+        _queue = nullptr;
+        return false;
+    }
+    _port = port;
+    _peeked = -1;
+    _flowControl = false;
+    return true;
+}
+
+void A9G_UartTransport::end()
+{
+    if (_port != UART_NUM_MAX)
+    {
+        uart_driver_delete(_port);
+        _port = UART_NUM_MAX;
+        _queue = nullptr;
+    }
+}
+
+void A9G_UartTransport::_events(TickType_t ticks)
+{
+    // Data events only say that the ring has bytes, which available() asks the driver directly; the
+    // queue is still emptied so error events are not crowded out.
+    uart_event_t event;
+    while (_queue && xQueueReceive(_queue, &event, ticks) == pdTRUE)
+    {
+        if (event.type == UART_FIFO_OVF)
+        {
+            fifoOverflows++;
+        }
+        else if (event.type == UART_BUFFER_FULL)
+        {
+            ringFull++;
+            ringLost += _flowControl ? 0 : 1;
+        }
+        ticks = 0;
+    }
+}
+
+int A9G_UartTransport::available()
+{
+    if (_port == UART_NUM_MAX)
+    {
+        return 0;
+    }
+    _events(0);
+    size_t buffered = 0;
+    uart_get_buffered_data_len(_port, &buffered);
+    return buffered + (_peeked >= 0 ? 1 : 0);
+}
+
+size_t A9G_UartTransport::read(uint8_t *buffer, size_t length)
+{
+    if (_port == UART_NUM_MAX || !length)
+    {
+        return 0;
+    }
+    size_t n = 0;
+    if (_peeked >= 0)
+    {
+        buffer[n++] = _peeked;
+        _peeked = -1;
+    }
+    int got = uart_read_bytes(_port, buffer + n, length - n, 0);
+    return got > 0 ? n + got : n;
+}
+
+int A9G_UartTransport::peek()
+{
+    if (_peeked < 0 && _port != UART_NUM_MAX)
+    {
+        uint8_t c;
+        if (uart_read_bytes(_port, &c, 1, 0) == 1)
+        {
+            _peeked = c;
+        }
+    }
+    return _peeked;
+}
+
+size_t A9G_UartTransport::write(const uint8_t *buffer, size_t size)
+{
+    if (_port == UART_NUM_MAX)
+    {
+        return 0;
+    }
+    int n = uart_write_bytes(_port, (const char *)buffer, size);
+    return n > 0 ? n : 0;
+}
+
+void A9G_UartTransport::flush()
+{
+    if (_port != UART_NUM_MAX)
+    {
+        uart_wait_tx_done(_port, portMAX_DELAY);
+    }
+}
+
+bool A9G_UartTransport::wait(unsigned long timeout_ms)
+{
+    if (available() > 0)
+    {
+        return true;
+    }
+    TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+    _events(timeout_ms && !ticks ? 1 : ticks);
+    return available() > 0;
+}
+
+bool A9G_UartTransport::setFlowControl(bool enable)
+{
+    // With RTS held back the driver can leave the FIFO full while its ring is full, nothing is lost.
+    if (_port == UART_NUM_MAX ||
+        uart_set_hw_flow_ctrl(_port, enable ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE, TRANSPORT_RTS_THRESHOLD) != ESP_OK)
+    {
+        return false;
+    }
+    _flowControl = enable;
+    return true;
+}
+
+uint32_t A9G_UartTransport::overruns()
+{
+    _events(0);
+    return fifoOverflows + ringLost;
+}
+#endif
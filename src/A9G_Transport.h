@@ -0,0 +1,172 @@
+/*!
+ * @file A9G_Transport.h
+ *
+ * Byte transport between GSM and the module.
+ *
+ * GSM only needs bulk, non-blocking reads and writes plus a way to sleep until data arrives.
+ * A9G_StreamTransport provides them on top of any Arduino Stream. A9G_UartTransport (ESP32 only)
+ * owns a UART through the ESP-IDF driver: the driver's interrupt handler moves the hardware FIFO
+ * into a large ring buffer, reads take whole blocks out of that ring with uart_read_bytes(), and
+ * waiting blocks on the driver's event queue instead of spinning, so nothing is lost while the
+ * sketch is busy elsewhere for as long as the ring holds.
+ *
+ * MIT license, (see LICENSE)
+ *
+ */
+
+#ifndef A9G_TRANSPORT_H
+#define A9G_TRANSPORT_H
+
+#include <Arduino.h>
+#include <Stream.h>
+
+#if defined(ESP32)
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#endif
+
+#ifndef TRANSPORT_RX_RING_SIZE
+#define TRANSPORT_RX_RING_SIZE 4096             // driver receive ring, about 350 ms at 115200 baud
+#endif
+#ifndef TRANSPORT_TX_RING_SIZE
+#define TRANSPORT_TX_RING_SIZE 1024             // driver transmit ring, 0 makes writes block until sent
+#endif
+#ifndef TRANSPORT_EVENT_QUEUE_SIZE
+#define TRANSPORT_EVENT_QUEUE_SIZE 16           // driver events kept between two reads
+#endif
+#ifndef TRANSPORT_RTS_THRESHOLD
+#define TRANSPORT_RTS_THRESHOLD 100             // FIFO bytes at which RTS is released, the FIFO holds 128
+#endif
+
+class A9G_Transport
+{
+public:
+    virtual ~A9G_Transport() {}
+
+    /**
+     * @brief Bytes that can be read without blocking.
+     */
+    virtual int available() = 0;
+
+    /**
+     * @brief Reads up to length bytes that are already received, without blocking.
+     *
+     * @return Number of bytes read.
+     */
+    virtual size_t read(uint8_t *buffer, size_t length) = 0;
+
+    /**
+     * @brief Next byte without removing it, -1 if none.
+     */
+    virtual int peek() = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+
+    /**
+     * @brief Waits until everything written is sent.
+     */
+    virtual void flush() {}
+
+    /**
+     * @brief Waits for received data.
+     *
+     * The default does not block, callers poll again.
+     *
+     * @param timeout_ms Longest time to wait.
+     * @return true if data is available.
+     */
+    virtual bool wait(unsigned long timeout_ms)
+    {
+        (void)timeout_ms;
+        return available() > 0;
+    }
+
+    /**
+     * @brief Turns RTS/CTS flow control on the host side on or off.
+     *
+     * @return false if the transport cannot do it, the port must then be set up by the sketch.
+     */
+    virtual bool setFlowControl(bool enable)
+    {
+        (void)enable;
+        return false;
+    }
+
+    /**
+     * @brief Receive overruns seen so far, 0 if the transport cannot detect them.
+     */
+    virtual uint32_t overruns()
+    {
+        return 0;
+    }
+};
+
+/**
+ * Compatibility transport over an Arduino Stream, used by GSM::init(Stream *).
+ */
+class A9G_StreamTransport : public A9G_Transport
+{
+private:
+    Stream *_stream = nullptr;
+
+public:
+    void begin(Stream *stream);
+
+    int available();
+    size_t read(uint8_t *buffer, size_t length);
+    int peek();
+    size_t write(const uint8_t *buffer, size_t size);
+    void flush();
+};
+
+#if defined(ESP32)
+/**
+ * ESP-IDF UART driver transport. The port must not be opened by HardwareSerial as well.
+ */
+class A9G_UartTransport : public A9G_Transport
+{
+private:
+    uart_port_t _port = UART_NUM_MAX;
+    QueueHandle_t _queue = nullptr;
+    int _peeked = -1;
+    bool _flowControl = false;
+
+    void _events(TickType_t ticks);
+
+public:
+    uint32_t fifoOverflows = 0; // hardware FIFO overran before the driver emptied it
+    uint32_t ringFull = 0;      // the receive ring was full; with flow control on the data was only held back
+    uint32_t ringLost = 0;      // the receive ring was full without flow control, data was lost
+
+    /**
+     * @brief Installs the UART driver and configures the port for 8N1.
+     *
+     * @param port UART number, e.g. UART_NUM_2.
+     * @param baud Baud rate, must match the module (AT+IPR).
+     * @param rx_pin GPIO connected to the module TX, UART_PIN_NO_CHANGE to keep the default.
+     * @param tx_pin GPIO connected to the module RX, UART_PIN_NO_CHANGE to keep the default.
+     * @param rts_pin GPIO connected to the module CTS, needed for setFlowControl().
+     * @param cts_pin GPIO connected to the module RTS, needed for setFlowControl().
+     * @return false if the driver could not be installed.
+     */
+    bool begin(uart_port_t port, uint32_t baud, int rx_pin = UART_PIN_NO_CHANGE, int tx_pin = UART_PIN_NO_CHANGE,
+               int rts_pin = UART_PIN_NO_CHANGE, int cts_pin = UART_PIN_NO_CHANGE);
+
+    /**
+     * @brief Removes the driver and frees its buffers.
+     */
+    void end();
+
+    int available();
+    size_t read(uint8_t *buffer, size_t length);
+    int peek();
+    size_t write(const uint8_t *buffer, size_t size);
+    void flush();
+    bool wait(unsigned long timeout_ms);
+    bool setFlowControl(bool enable);
+    uint32_t overruns();
+};
+#endif
+
+#endif